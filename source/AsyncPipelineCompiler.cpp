@@ -0,0 +1,172 @@
+#include <condition_variable>
+#include <deque>
+#include "AsyncPipelineCompiler.h"
+#include "CRHooks.h"
+#include "DebuggingUtil.h"
+#include "PatchedPipelineLibrary.h"
+
+namespace AsyncPipelineCompiler
+{
+	constexpr uint32_t MaxWorkerThreads = 8;
+
+	struct CompileRequest
+	{
+		CComPtr<ID3D12Device2> Device;
+		CreationRenderer::TechniqueData *Technique;
+		std::string TechniqueName;
+		uint64_t TechniqueId;
+		D3DPipelineStateStream::Copy StreamCopy;
+		std::optional<D3DPipelineStateStream::Fingerprint> Fingerprint;
+	};
+
+	// Techniques that asked for a pipeline already queued or compiling. They run with their vanilla stand-in
+	// and get the same patched pipeline swapped in once it exists.
+	struct Follower
+	{
+		CreationRenderer::TechniqueData *Technique;
+		D3DPipelineStateStream::Copy StreamCopy;
+	};
+
+	struct PendingKeyHash
+	{
+		size_t operator()(const std::pair<uint64_t, D3DPipelineStateStream::Fingerprint>& Key) const
+		{
+			// Fingerprints are already well distributed
+			return static_cast<size_t>(Key.first ^ Key.second.Low);
+		}
+	};
+
+	std::mutex QueueLock;
+	std::condition_variable QueueCondition;
+	std::deque<CompileRequest> Queue;
+	std::unordered_map<std::pair<uint64_t, D3DPipelineStateStream::Fingerprint>, std::vector<Follower>, PendingKeyHash> Pending;
+
+	// Command lists recorded before the swap may still reference the vanilla pipelines. There's no way to tell
+	// when the GPU is done with them, so they're kept alive for the rest of the session.
+	std::mutex RetiredPipelineLock;
+	std::vector<CComPtr<ID3D12PipelineState>> RetiredPipelines;
+
+	void SwapPipeline(CreationRenderer::TechniqueData *Technique, CComPtr<ID3D12PipelineState> PipelineState)
+	{
+		// The game owns exactly one reference to whatever m_PipelineState points at. Hand ours over and take
+		// the vanilla pipeline's reference in exchange.
+		auto oldValue = std::atomic_ref(Technique->m_PipelineState).exchange(PipelineState.Detach());
+
+		std::scoped_lock lock(RetiredPipelineLock);
+		RetiredPipelines.emplace_back().Attach(oldValue);
+	}
+
+	void Compile(CompileRequest& Request)
+	{
+		CComPtr<ID3D12PipelineState> pipelineState;
+
+		const auto hr = Request.Device->CreatePipelineState(Request.StreamCopy.GetDesc(), IID_PPV_ARGS(&pipelineState));
+
+		if (SUCCEEDED(hr) && Request.Fingerprint)
+			PatchedPipelineLibrary::Store(Request.TechniqueId, *Request.Fingerprint, pipelineState.Get());
+
+		// Requests arriving after this point find the pipeline in the patched library, or queue a new compile if
+		// storing failed
+		std::vector<Follower> followers;
+
+		if (Request.Fingerprint)
+		{
+			std::scoped_lock lock(QueueLock);
+
+			if (auto node = Pending.extract({ Request.TechniqueId, *Request.Fingerprint }))
+				followers = std::move(node.mapped());
+		}
+
+		if (FAILED(hr))
+		{
+			spdlog::error(
+				"Background CreatePipelineState failed and returned {:X}. Keeping the vanilla pipeline. Shader technique: {:X}.",
+				static_cast<uint32_t>(hr),
+				Request.TechniqueId);
+		}
+		else
+		{
+			DebuggingUtil::SetObjectDebugName(pipelineState.Get(), Request.TechniqueName.c_str());
+
+			for (const auto& follower : followers)
+				SwapPipeline(follower.Technique, pipelineState);
+
+			SwapPipeline(Request.Technique, std::move(pipelineState));
+		}
+
+		// Tracked either way. After a failure the vanilla pipeline is still in place, and live updates get another
+		// chance to swap in a fixed replacement.
+		//
+		// Only pipelines without a root signature override come through here. There's nothing for the layout hook to
+		// track and OverridePipelineLayoutDx12 reads that table without a lock.
+		for (auto& follower : followers)
+			CRHooks::TrackCompiledTechnique(Request.Device, follower.Technique, std::move(follower.StreamCopy), false);
+
+		CRHooks::TrackCompiledTechnique(Request.Device, Request.Technique, std::move(Request.StreamCopy), false);
+	}
+
+	void WorkerThread()
+	{
+		while (true)
+		{
+			std::unique_lock lock(QueueLock);
+			QueueCondition.wait(lock, [] { return !Queue.empty(); });
+
+			auto request = std::move(Queue.front());
+			Queue.pop_front();
+			lock.unlock();
+
+			Compile(request);
+		}
+	}
+
+	void Enqueue(
+		CComPtr<ID3D12Device2> Device,
+		CreationRenderer::TechniqueData *Technique,
+		const char *TechniqueName,
+		uint64_t TechniqueId,
+		D3DPipelineStateStream::Copy&& StreamCopy,
+		std::optional<D3DPipelineStateStream::Fingerprint> Fingerprint)
+	{
+		static bool once = []
+		{
+			// Driver compiles are CPU bound. Leave half the cores for the game's own loading threads.
+			const auto threadCount = std::clamp<uint32_t>(std::thread::hardware_concurrency() / 2, 1, MaxWorkerThreads);
+
+			for (uint32_t i = 0; i < threadCount; i++)
+				std::thread(WorkerThread).detach();
+
+			return true;
+		}();
+
+		// The stream still points into memory owned by the game
+		CRHooks::RetainStream(StreamCopy);
+
+		{
+			std::scoped_lock lock(QueueLock);
+
+			if (Fingerprint)
+			{
+				// Already queued or compiling. Never wait for it here, the caller is a game thread.
+				auto [itr, inserted] = Pending.try_emplace({ TechniqueId, *Fingerprint });
+
+				if (!inserted)
+				{
+					itr->second.emplace_back(Follower { .Technique = Technique, .StreamCopy = std::move(StreamCopy) });
+					return;
+				}
+			}
+
+			Queue.emplace_back(CompileRequest {
+				.Device = std::move(Device),
+				.Technique = Technique,
+				.TechniqueName = TechniqueName,
+				.TechniqueId = TechniqueId,
+				.StreamCopy = std::move(StreamCopy),
+				.Fingerprint = Fingerprint,
+			});
+		}
+
+		QueueCondition.notify_one();
+	}
+}
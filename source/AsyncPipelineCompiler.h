@@ -0,0 +1,23 @@
+#pragma once
+
+#include "RE/CreationRenderer.h"
+#include "CComPtr.h"
+#include "D3DPipelineStateStream.h"
+
+namespace AsyncPipelineCompiler
+{
+	// Compiles a patched pipeline on a worker thread while the game runs with the vanilla pipeline. Once the
+	// driver is done, the patched pipeline is swapped into Technique->m_PipelineState. If the compile fails, the
+	// vanilla pipeline is kept. The technique is handed to CRHooks::TrackCompiledTechnique in both cases.
+	//
+	// Technique must point into the game's global technique table, not at a temporary. The vanilla pipeline has
+	// to be stored in Technique->m_PipelineState before this is called. TechniqueName is copied. Requests with the
+	// same fingerprint as one still pending return immediately and get that compile's result swapped in too.
+	void Enqueue(
+		CComPtr<ID3D12Device2> Device,
+		CreationRenderer::TechniqueData *Technique,
+		const char *TechniqueName,
+		uint64_t TechniqueId,
+		D3DPipelineStateStream::Copy&& StreamCopy,
+		std::optional<D3DPipelineStateStream::Fingerprint> Fingerprint);
+}
@@ -0,0 +1,51 @@
+#include <xbyak/xbyak.h>
+#include "CRHooks.h"
+
+namespace CRHooks
+{
+	class SetPipelineLayoutDx12HookGen : Xbyak::CodeGenerator
+	{
+	private:
+		const uintptr_t m_TargetAddress;
+
+	public:
+		SetPipelineLayoutDx12HookGen(uintptr_t TargetAddress) : m_TargetAddress(TargetAddress)
+		{
+			Xbyak::Label emulateSetNewSignature;
+
+			lea(r9, ptr[rsi + 0x8]);
+			mov(ptr[rsp + 0x20], r9);  // a5: Target Technique**
+			mov(r9, r15);			   // a4: Current Technique**
+			mov(r8, r13);			   // a3: Target PipelineLayoutDx12
+			mov(rdx, ptr[rcx + 0x18]); // a2: Current PipelineLayoutDx12
+			mov(rcx, ptr[r14 + 0x10]); // a1: ID3D12GraphicsCommandList
+			mov(rax, reinterpret_cast<uintptr_t>(&OverridePipelineLayoutDx12));
+			call(rax);
+
+			test(al, al);
+			jnz(emulateSetNewSignature);
+
+			// Run the original code
+			mov(rax, m_TargetAddress + 0x73);
+			jmp(rax);
+
+			// New signature required. OverridePipelineLayoutDx12() is expected to pass a signature to the D3D12 API
+			// before we get here. This bypasses Starfield's calls to ID3D12CommandList::SetXXXRootSignature().
+			L(emulateSetNewSignature);
+			mov(rax, m_TargetAddress + 0x60);
+			jmp(rax);
+		}
+
+		void Patch()
+		{
+			Hooks::WriteJump(m_TargetAddress, getCode());
+		}
+	};
+
+	DECLARE_HOOK_TRANSACTION(CRHooks)
+	{
+		static SetPipelineLayoutDx12HookGen setPipelineLayoutDx12Hook(
+			Offsets::Signature("4C 39 69 18 74 6D 41 8B C8 83 E9 01 74 41 83 E9 01 74 29 83 F9 01 74 24 41 8B C8 83 E9 01 74 40"));
+		setPipelineLayoutDx12Hook.Patch();
+	};
+}
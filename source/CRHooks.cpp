@@ -1,9 +1,15 @@
-#include <xbyak/xbyak.h>
 #include "D3DShaderReplacement.h"
 #include "DebuggingUtil.h"
 #include "CRHooks.h"
+#include "LoadStatistics.h"
+#include "PatchedPipelineLibrary.h"
+#include "PipelineCapture.h"
+#include "PipelineWarmup.h"
+#include "Platform.h"
 #include "Plugin.h"
 #include "ReShadeHelper.h"
+#include "ShaderBlobCache.h"
+#include "ShaderDumpWriter.h"
 
 namespace CRHooks
 {
@@ -16,84 +22,88 @@ namespace CRHooks
 	std::mutex TrackedShaderDataLock;
 	std::vector<TrackedDataEntry> TrackedPipelineData;
 	std::unordered_map<uint64_t, CComPtr<ID3D12RootSignature>> TrackedTechniqueIdToRootSignature;
+	size_t TrackedStreamBytes = 0;
 
-	void LiveUpdateFilesystemWatcherThread(CComPtr<ID3D12Device2> Device)
+	size_t RefreshTrackedPipelines(ID3D12Device2 *Device)
 	{
-		const auto changeHandle = FindFirstChangeNotificationW(
-			D3DShaderReplacement::GetShaderBinDirectory().c_str(),
-			true,
-			FILE_NOTIFY_CHANGE_LAST_WRITE);
+		std::scoped_lock lock(TrackedShaderDataLock);
+		size_t patchCounter = 0;
 
-		if (changeHandle == INVALID_HANDLE_VALUE)
+		for (auto& data : TrackedPipelineData)
 		{
-			spdlog::error("Live update: FindFirstChangeNotification failed with error code {:X}.", GetLastError());
-			return;
-		}
+			const bool newPipelineRequired = D3DShaderReplacement::PatchPipelineStateStream(
+				data.StreamCopy,
+				Device,
+				nullptr,
+				data.Technique->m_Name,
+				data.Technique->m_Id);
+
+			if (!newPipelineRequired)
+				continue;
+
+			CComPtr<ID3D12PipelineState> pipelineState;
+			if (auto hr = Device->CreatePipelineState(data.StreamCopy.GetDesc(), IID_PPV_ARGS(&pipelineState)); FAILED(hr))
+			{
+				spdlog::error(
+					"Live update: Failed to compile pipeline: {:X}. Shader technique: {:X}.",
+					static_cast<uint32_t>(hr),
+					data.Technique->m_Id);
 
-		spdlog::info("Live update: Initialized.");
+				continue;
+			}
 
-		while (true)
-		{
-			const auto status = WaitForSingleObject(changeHandle, INFINITE);
+			DebuggingUtil::SetObjectDebugName(pipelineState.Get(), data.Technique->m_Name);
 
-			if (status != WAIT_OBJECT_0)
-				break;
+			// pipelineState->AddRef() is needed due to CComPtr's destructor. Luckily for us, the game keeps
+			// exactly 1 reference to the old state so we don't have to fix mismatched reference counts.
+			//
+			// WARNING: This'll never be thread safe. It's meant as a developer tool, not for production.
+			//
+			// HACK: oldValue is never released. It's not stable and leaks memory for now.
+			pipelineState->AddRef();
 
-			// Update all known shaders in the directory. The loop might run multiple times if multiple files are
-			// changed but that's okay.
-			TrackedShaderDataLock.lock();
-			{
-				size_t patchCounter = 0;
+			auto oldValue = std::atomic_ref(data.Technique->m_PipelineState).exchange(pipelineState.Get());
+			(void)oldValue; // ->Release();
 
-				for (auto& data : TrackedPipelineData)
-				{
-					const bool newPipelineRequired = D3DShaderReplacement::PatchPipelineStateStream(
-						data.StreamCopy,
-						Device.Get(),
-						nullptr,
-						data.Technique->m_Name,
-						data.Technique->m_Id);
-
-					if (!newPipelineRequired)
-						continue;
-
-					CComPtr<ID3D12PipelineState> pipelineState;
-					if (auto hr = Device->CreatePipelineState(data.StreamCopy.GetDesc(), IID_PPV_ARGS(&pipelineState)); FAILED(hr))
-					{
-						spdlog::error(
-							"Live update: Failed to compile pipeline: {:X}. Shader technique: {:X}.",
-							static_cast<uint32_t>(hr),
-							data.Technique->m_Id);
+			patchCounter++;
+		}
 
-						continue;
-					}
+		if (patchCounter > 0)
+			spdlog::info("Live update: Created pipelines for {} technique(s).", patchCounter);
 
-					DebuggingUtil::SetObjectDebugName(pipelineState.Get(), data.Technique->m_Name);
+		return patchCounter;
+	}
 
-					// pipelineState->AddRef() is needed due to CComPtr's destructor. Luckily for us, the game keeps
-					// exactly 1 reference to the old state so we don't have to fix mismatched reference counts.
-					//
-					// WARNING: This'll never be thread safe. It's meant as a developer tool, not for production.
-					//
-					// HACK: oldValue is never released. It's not stable and leaks memory for now.
-					pipelineState->AddRef();
+	void LiveUpdateFilesystemWatcherThread(CComPtr<ID3D12Device2> Device)
+	{
+		spdlog::info("Live update: Watching {} for changes.", D3DShaderReplacement::GetShaderBinDirectory().string());
 
-					auto targetPointer = reinterpret_cast<void **>(&data.Technique->m_PipelineState);
-					auto oldValue = InterlockedExchangePointer(targetPointer, pipelineState.Get());
-					(void)oldValue; // ->Release();
+		const auto ec = Platform::WatchDirectory(
+			D3DShaderReplacement::GetShaderBinDirectory(),
+			[&]()
+			{
+				// Update all known shaders in the directory. The callback might run multiple times if multiple files are
+				// changed but that's okay. Files may have been added or removed, so sources have to be re-indexed first.
+				D3DShaderReplacement::RefreshReplacementSources();
 
-					patchCounter++;
-				}
+				RefreshTrackedPipelines(Device.Get());
+			});
 
-				if (patchCounter > 0)
-					spdlog::info("Live update: Created pipelines for {} technique(s).", patchCounter);
-			}
-			TrackedShaderDataLock.unlock();
+		spdlog::error("Live update: Watching for file changes failed with error code {:X}.", static_cast<uint32_t>(ec.value()));
+	}
 
-			FindNextChangeNotification(changeHandle);
+	void SaveSessionData()
+	{
+		// The end of a loading burst is also the end of a dump pass
+		if (!Plugin::ShaderDumpBinPath.empty())
+			ShaderDumpWriter::Checkpoint();
+		else
+		{
+			PatchedPipelineLibrary::Save();
+			PipelineWarmup::Save();
 		}
 
-		FindCloseChangeNotification(changeHandle);
+		PipelineCapture::Flush();
 	}
 
 	void TrackDevice(CComPtr<ID3D12Device2> Device)
@@ -103,11 +113,49 @@ namespace CRHooks
 			if (Plugin::AllowLiveUpdates)
 				std::thread(LiveUpdateFilesystemWatcherThread, Device).detach();
 
+			PatchedPipelineLibrary::Initialize(Device.Get());
+			PipelineWarmup::Initialize(Device.Get());
 			ReShadeHelper::Initialize();
+
+			// Loading screens are the only time the game reliably stops creating pipelines. Nothing is saved at
+			// process exit.
+			LoadStatistics::AddIdleCallback(SaveSessionData);
 			return true;
 		}();
 	}
 
+	void RetainStream(D3DPipelineStateStream::Copy& StreamCopy)
+	{
+		if (Plugin::AllowLiveUpdates)
+		{
+			// Most game shaders are shared between many techniques. Reference one interned copy of each instead
+			// of letting Retain() duplicate the bytecode for every pipeline. Replacements are already shared.
+			D3DPipelineStateStream::ForEachSubobject(
+				StreamCopy.GetDesc(),
+				[&](auto Type, auto& Payload)
+				{
+					if constexpr (D3DPipelineStateStream::IsShaderSubobjectType(Type))
+					{
+						if (!Payload.pShaderBytecode || StreamCopy.IsOwned(Payload.pShaderBytecode))
+							return;
+
+						auto blob = ShaderBlobCache::Intern(
+							{ static_cast<const uint8_t *>(Payload.pShaderBytecode), Payload.BytecodeLength });
+
+						if (!blob)
+							return;
+
+						const auto data = blob->GetData();
+						Payload.pShaderBytecode = data.data();
+						StreamCopy.TrackSharedData(std::move(blob), data);
+					}
+				});
+		}
+
+		// Everything else still points into memory owned by the game
+		StreamCopy.Retain();
+	}
+
 	void TrackCompiledTechnique(
 		CComPtr<ID3D12Device2> Device,
 		CreationRenderer::TechniqueData *Technique,
@@ -117,21 +165,26 @@ namespace CRHooks
 		// Root signature override has to be tracked
 		if (WasPatchedUpfront)
 		{
-			for (D3DPipelineStateStream::Iterator iter(StreamCopy.GetDesc()); !iter.AtEnd(); iter.Advance())
-			{
-				switch (auto obj = iter.GetObj(); obj->Type)
+			D3DPipelineStateStream::ForEachSubobject(
+				StreamCopy.GetDesc(),
+				[&](auto Type, auto& Payload)
 				{
-				case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE:
-					std::scoped_lock lock(TrackedShaderDataLock);
-					TrackedTechniqueIdToRootSignature.emplace(Technique->m_Id, obj->RootSignature);
-					break;
-				}
-			}
+					if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE)
+					{
+						std::scoped_lock lock(TrackedShaderDataLock);
+						TrackedTechniqueIdToRootSignature.emplace(Technique->m_Id, Payload);
+					}
+				});
 		}
 
 		if (Plugin::AllowLiveUpdates)
 		{
+			// Background compiles were retained when they were queued
+			if (!StreamCopy.IsRetained())
+				RetainStream(StreamCopy);
+
 			std::scoped_lock lock(TrackedShaderDataLock);
+			TrackedStreamBytes += StreamCopy.GetArenaSize();
 			TrackedPipelineData.emplace_back(TrackedDataEntry {
 				.Technique = Technique,
 				.StreamCopy = std::move(StreamCopy),
@@ -139,11 +192,32 @@ namespace CRHooks
 		}
 	}
 
+	TrackedMemoryStatistics GetTrackedMemoryStatistics()
+	{
+		std::scoped_lock lock(TrackedShaderDataLock);
+
+		return TrackedMemoryStatistics {
+			.PipelineCount = TrackedPipelineData.size(),
+			.StreamBytes = TrackedStreamBytes,
+		};
+	}
+
+	struct BoundRootSignatures
+	{
+		ID3D12RootSignature *Graphics = nullptr;
+		ID3D12RootSignature *Compute = nullptr;
+	};
+
+	// Root signatures passed to each command list by OverridePipelineLayoutDx12. Every bind goes through the hook.
+	// A command list is recorded by one thread between Reset() and Close(), and the game only considers a layout
+	// current if it was set during that recording, so this thread's entry is accurate whenever it's consulted.
+	thread_local std::unordered_map<ID3D12GraphicsCommandList4 *, BoundRootSignatures> TLBoundRootSignatures;
+
 	bool OverridePipelineLayoutDx12(
 		ID3D12GraphicsCommandList4 *CommandList,
 		CreationRenderer::PipelineLayoutDx12 *CurrentLayout,
 		CreationRenderer::PipelineLayoutDx12 *TargetLayout,
-		CreationRenderer::TechniqueData **CurrentTech,
+		[[maybe_unused]] CreationRenderer::TechniqueData **CurrentTech,
 		CreationRenderer::TechniqueData **TargetTech)
 	{
 		//
@@ -157,22 +231,33 @@ namespace CRHooks
 		bool updateRequired = CurrentLayout != TargetLayout;
 		auto rootSignature = TargetLayout->m_RootSignature;
 
-		// If the target technique requires an override OR the previous technique was overridden, force a flush
-		if (auto itr = TrackedTechniqueIdToRootSignature.find((*TargetTech)->m_Id); itr != TrackedTechniqueIdToRootSignature.end())
-		{
-			updateRequired = true;
-			rootSignature = itr->second.Get();
-		}
-		else if (!updateRequired && CurrentTech)
+		const auto findOverride = [](CreationRenderer::TechniqueData *Tech) -> ID3D12RootSignature *
 		{
-			updateRequired = TrackedTechniqueIdToRootSignature.contains((*CurrentTech)->m_Id);
-		}
+			if (auto itr = TrackedTechniqueIdToRootSignature.find(Tech->m_Id); itr != TrackedTechniqueIdToRootSignature.end())
+				return itr->second.Get();
+
+			return nullptr;
+		};
+
+		if (auto signature = findOverride(*TargetTech))
+			rootSignature = signature;
+
+		const auto type = *reinterpret_cast<CreationRenderer::ShaderType *>(
+			reinterpret_cast<uintptr_t>(TargetLayout->m_LayoutConfigurationData) + 0x4);
+		const bool isGraphics = type == CreationRenderer::ShaderType::Graphics;
+
+		// Within the same layout, compare against what this hook last bound. The current technique's override can't
+		// be trusted for that since live updates may have added or changed it after it was bound. Overrides are
+		// shared between techniques with identical blobs so consecutive overridden techniques often don't need a
+		// rebind at all.
+		auto& boundSignatures = TLBoundRootSignatures[CommandList];
+		auto& boundSignature = isGraphics ? boundSignatures.Graphics : boundSignatures.Compute;
+
+		if (!updateRequired)
+			updateRequired = boundSignature != rootSignature;
 
 		if (updateRequired)
 		{
-			const auto type = *reinterpret_cast<CreationRenderer::ShaderType *>(
-				reinterpret_cast<uintptr_t>(TargetLayout->m_LayoutConfigurationData) + 0x4);
-
 			switch (type)
 			{
 			case CreationRenderer::ShaderType::Graphics:
@@ -184,54 +269,10 @@ namespace CRHooks
 				CommandList->SetComputeRootSignature(rootSignature);
 				break;
 			}
+
+			boundSignature = rootSignature;
 		}
 
 		return updateRequired;
 	}
-
-	class SetPipelineLayoutDx12HookGen : Xbyak::CodeGenerator
-	{
-	private:
-		const uintptr_t m_TargetAddress;
-
-	public:
-		SetPipelineLayoutDx12HookGen(uintptr_t TargetAddress) : m_TargetAddress(TargetAddress)
-		{
-			Xbyak::Label emulateSetNewSignature;
-
-			lea(r9, ptr[rsi + 0x8]);
-			mov(ptr[rsp + 0x20], r9);  // a5: Target Technique**
-			mov(r9, r15);			   // a4: Current Technique**
-			mov(r8, r13);			   // a3: Target PipelineLayoutDx12
-			mov(rdx, ptr[rcx + 0x18]); // a2: Current PipelineLayoutDx12
-			mov(rcx, ptr[r14 + 0x10]); // a1: ID3D12GraphicsCommandList
-			mov(rax, reinterpret_cast<uintptr_t>(&OverridePipelineLayoutDx12));
-			call(rax);
-
-			test(al, al);
-			jnz(emulateSetNewSignature);
-
-			// Run the original code
-			mov(rax, m_TargetAddress + 0x73);
-			jmp(rax);
-
-			// New signature required. OverridePipelineLayoutDx12() is expected to pass a signature to the D3D12 API
-			// before we get here. This bypasses Starfield's calls to ID3D12CommandList::SetXXXRootSignature().
-			L(emulateSetNewSignature);
-			mov(rax, m_TargetAddress + 0x60);
-			jmp(rax);
-		}
-
-		void Patch()
-		{
-			Hooks::WriteJump(m_TargetAddress, getCode());
-		}
-	};
-
-	DECLARE_HOOK_TRANSACTION(CRHooks)
-	{
-		static SetPipelineLayoutDx12HookGen setPipelineLayoutDx12Hook(
-			Offsets::Signature("4C 39 69 18 74 6D 41 8B C8 83 E9 01 74 41 83 E9 01 74 29 83 F9 01 74 24 41 8B C8 83 E9 01 74 40"));
-		setPipelineLayoutDx12Hook.Patch();
-	};
 }
@@ -6,11 +6,37 @@
 
 namespace CRHooks
 {
+	struct TrackedMemoryStatistics
+	{
+		size_t PipelineCount = 0;
+		size_t StreamBytes = 0; // Retained streams and non-shader buffers
+	};
+
 	void TrackDevice(CComPtr<ID3D12Device2> Device);
 
+	// Takes ownership of everything StreamCopy still borrows from the game. With live updates enabled, game shaders
+	// are interned first so identical bytecode is shared between streams. Has to run before anything else retains
+	// the stream, since retained shaders can't be interned anymore.
+	void RetainStream(D3DPipelineStateStream::Copy& StreamCopy);
+
 	void TrackCompiledTechnique(
 		CComPtr<ID3D12Device2> Device,
 		CreationRenderer::TechniqueData *Technique,
 		D3DPipelineStateStream::Copy&& StreamCopy,
 		bool WasPatchedUpfront);
+
+	TrackedMemoryStatistics GetTrackedMemoryStatistics();
+
+	// Re-patches every tracked stream and swaps in new pipelines where the replacement shaders changed. Returns the
+	// number of techniques updated. Replacement sources have to be refreshed by the caller.
+	size_t RefreshTrackedPipelines(ID3D12Device2 *Device);
+
+	// Target of the root signature binding hook in CRHookPatches.cpp. Returns true if it bound a root signature on
+	// CommandList itself, false if nothing changed.
+	bool OverridePipelineLayoutDx12(
+		ID3D12GraphicsCommandList4 *CommandList,
+		CreationRenderer::PipelineLayoutDx12 *CurrentLayout,
+		CreationRenderer::PipelineLayoutDx12 *TargetLayout,
+		CreationRenderer::TechniqueData **CurrentTech,
+		CreationRenderer::TechniqueData **TargetTech);
 }
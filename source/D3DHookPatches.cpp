@@ -0,0 +1,95 @@
+#include <xbyak/xbyak.h>
+#include "D3DHooks.h"
+
+namespace D3DHooks
+{
+	//
+	// Trampolines from the game's pipeline library and device calls into D3DHooks.cpp. They pass along the technique
+	// the game is working on, which isn't part of the D3D12 signatures.
+	//
+	class LoadPipelineHookGen : Xbyak::CodeGenerator
+	{
+	private:
+		const uintptr_t m_TargetAddress;
+
+	public:
+		LoadPipelineHookGen(uintptr_t TargetAddress) : m_TargetAddress(TargetAddress)
+		{
+			mov(ptr[rsp + 0x28], r12); // a6: Technique pointer
+			mov(rax, reinterpret_cast<uintptr_t>(&LoadPipelineForTechnique));
+			call(rax);
+			test(eax, eax);
+
+			jmp(ptr[rip]);
+			dq(m_TargetAddress + 0x5);
+		}
+
+		void Patch()
+		{
+			Hooks::WriteJump(m_TargetAddress, getCode());
+		}
+	};
+
+	class StorePipelineHookGen : Xbyak::CodeGenerator
+	{
+	private:
+		const uintptr_t m_TargetAddress;
+
+	public:
+		StorePipelineHookGen(uintptr_t TargetAddress) : m_TargetAddress(TargetAddress)
+		{
+			mov(r9, r12); // a4: Technique pointer
+			mov(rax, reinterpret_cast<uintptr_t>(&StorePipelineForTechnique));
+			call(rax);
+			mov(ebx, eax);
+
+			jmp(ptr[rip]);
+			dq(m_TargetAddress + 0x5);
+		}
+
+		void Patch()
+		{
+			Hooks::WriteJump(m_TargetAddress, getCode());
+		}
+	};
+
+	class CreatePipelineStateHookGen : Xbyak::CodeGenerator
+	{
+	private:
+		const uintptr_t m_TargetAddress;
+
+	public:
+		CreatePipelineStateHookGen(uintptr_t TargetAddress) : m_TargetAddress(TargetAddress)
+		{
+			mov(ptr[rsp + 0x20], r12); // a5: Technique pointer
+			mov(rax, reinterpret_cast<uintptr_t>(&CreatePipelineStateForTechnique));
+			call(rax);
+
+			jmp(ptr[rip]);
+			dq(m_TargetAddress + 0x6);
+		}
+
+		void Patch()
+		{
+			Hooks::WriteJump(m_TargetAddress, getCode());
+		}
+	};
+
+	DECLARE_HOOK_TRANSACTION(D3DHooks)
+	{
+		static LoadPipelineHookGen loadPipelineHook(
+			Offsets::Signature("FF 50 68 85 C0 0F 89 ? ? ? ? 49 8B 8F ? ? ? ? 48 8B 01 4C 8B CF 4C 8D"));
+		loadPipelineHook.Patch();
+
+		static StorePipelineHookGen storePipelineHook(Offsets::Signature("FF 50 40 8B D8 85 C0 0F 89 ? ? ? ? 45 33 E4 4C 89 64 24 58"));
+		storePipelineHook.Patch();
+
+		static CreatePipelineStateHookGen createPipelineStateHook1(
+			Offsets::Signature("FF 90 78 01 00 00 8B D8 41 BD FF FF FF FF 85 C0 0F 89 ? ? ? ? 33 C0"));
+		createPipelineStateHook1.Patch();
+
+		static CreatePipelineStateHookGen createPipelineStateHook2(
+			Offsets::Signature("FF 90 78 01 00 00 8B D8 85 C0 0F 89 ? ? ? ? 4C 89 6C 24 68"));
+		createPipelineStateHook2.Patch();
+	};
+}
@@ -1,10 +1,16 @@
-#include <xbyak/xbyak.h>
 #include "RE/CreationRenderer.h"
+#include "AsyncPipelineCompiler.h"
 #include "CComPtr.h"
 #include "CRHooks.h"
 #include "D3DShaderReplacement.h"
 #include "DebuggingUtil.h"
-#include "D3Dhooks.h"
+#include "D3DHooks.h"
+#include "InFlightPipelines.h"
+#include "LoadStatistics.h"
+#include "PatchedPipelineLibrary.h"
+#include "PipelineCapture.h"
+#include "PipelineWarmup.h"
+#include "Plugin.h"
 
 namespace D3DHooks
 {
@@ -23,7 +29,7 @@ namespace D3DHooks
 	//
 	thread_local CComPtr<ID3D12PipelineLibrary1> TLLastRequestedPipelineLibrary;
 	thread_local CreationRenderer::TechniqueData *TLLastRequestedShaderTechnique;
-	thread_local wchar_t TLLastRequestedPipelineName[64];
+	thread_local std::wstring TLLastRequestedPipelineName;
 
 	HRESULT LoadPipelineForTechnique(
 		ID3D12PipelineLibrary1 *Thisptr,
@@ -35,34 +41,11 @@ namespace D3DHooks
 	{
 		TLLastRequestedPipelineLibrary = Thisptr;
 		TLLastRequestedShaderTechnique = Tech;
-		wcscpy_s(TLLastRequestedPipelineName, Name);
+		TLLastRequestedPipelineName = Name;
 
 		return E_INVALIDARG;
 	}
 
-	class LoadPipelineHookGen : Xbyak::CodeGenerator
-	{
-	private:
-		const uintptr_t m_TargetAddress;
-
-	public:
-		LoadPipelineHookGen(uintptr_t TargetAddress) : m_TargetAddress(TargetAddress)
-		{
-			mov(ptr[rsp + 0x28], r12); // a6: Technique pointer
-			mov(rax, reinterpret_cast<uintptr_t>(&LoadPipelineForTechnique));
-			call(rax);
-			test(eax, eax);
-
-			jmp(ptr[rip]);
-			dq(m_TargetAddress + 0x5);
-		}
-
-		void Patch()
-		{
-			Hooks::WriteJump(m_TargetAddress, getCode());
-		}
-	};
-
 	//
 	// Similar to LoadPipeline above, but for storing pipeline state. CreatePipelineStateForTechnique determines
 	// whether this gets called by setting TLNextShaderTechniqueToSkipCaching. We don't want modified shaders to
@@ -89,29 +72,6 @@ namespace D3DHooks
 		return Thisptr->StorePipeline(Name, Pipeline);
 	}
 
-	class StorePipelineHookGen : Xbyak::CodeGenerator
-	{
-	private:
-		const uintptr_t m_TargetAddress;
-
-	public:
-		StorePipelineHookGen(uintptr_t TargetAddress) : m_TargetAddress(TargetAddress)
-		{
-			mov(r9, r12); // a4: Technique pointer
-			mov(rax, reinterpret_cast<uintptr_t>(&StorePipelineForTechnique));
-			call(rax);
-			mov(ebx, eax);
-
-			jmp(ptr[rip]);
-			dq(m_TargetAddress + 0x5);
-		}
-
-		void Patch()
-		{
-			Hooks::WriteJump(m_TargetAddress, getCode());
-		}
-	};
-
 	//
 	// Pipeline state object creation. This is the main hook where shader bytecode gets replaced.
 	//
@@ -128,49 +88,133 @@ namespace D3DHooks
 	{
 		CRHooks::TrackDevice(Thisptr);
 
-		if (Riid != __uuidof(ID3D12PipelineState))
+		if (Riid != IID_ID3D12PipelineState)
 			return E_NOINTERFACE;
 
 		*PipelineState = nullptr;
+		const auto startTime = std::chrono::steady_clock::now();
 
 		// Note that streamCopy is initially a 1:1 copy since Desc is const. We don't know if a modification
-		// is applied until PatchPipelineStateStream returns.
-		D3DPipelineStateStream::Copy streamCopy(Desc);
-		const std::span rootSignatureData(Tech->m_Inputs->m_RootSignatureBlob, Tech->m_Inputs->m_RootSignatureBlobSize);
+		// is applied until PatchPipelineStateStream returns. Only the subobject stream is duplicated; shaders
+		// and other buffers are still read from Desc.
+		auto streamCopy = [&]()
+		{
+			LoadStatistics::ScopedPhaseTimer timer(LoadStatistics::Phase::StreamCopy);
+			return D3DPipelineStateStream::Copy(Desc);
+		}();
+
+		std::span rootSignatureData(Tech->m_Inputs->m_RootSignatureBlob, Tech->m_Inputs->m_RootSignatureBlobSize);
+
+		// Captures need the vanilla stream. Flatten it before anything gets patched.
+		const auto capturedStream = PipelineCapture::IsEnabled() ? streamCopy.Serialize() : std::vector<uint8_t>();
+		const auto vanillaRootSignatureData = rootSignatureData;
 
 		// shaderWasPatched will be true if ANY part of the pipeline state stream is modified by code. If so,
-		// the pipeline state has to be created from scratch. Otherwise ask the pipeline library interface for
-		// a precompiled copy.
+		// the game's pipeline library can't be used and our own is checked instead. Otherwise ask the game's
+		// pipeline library interface for a precompiled copy.
 		bool shaderWasPatched = false;
 		bool shaderWasLoadedFromCache = false;
+		bool compileInBackground = false;
+		bool shaderWasWarmed = false;
+		std::optional<D3DPipelineStateStream::Fingerprint> patchedFingerprint;
 
-		if (D3DShaderReplacement::PatchPipelineStateStream(streamCopy, Thisptr, &rootSignatureData, Tech->m_Name, Tech->m_Id))
 		{
-			shaderWasPatched = true;
+			LoadStatistics::ScopedPhaseTimer timer(LoadStatistics::Phase::PatchLookup);
+			shaderWasPatched =
+				D3DShaderReplacement::PatchPipelineStateStream(streamCopy, Thisptr, &rootSignatureData, Tech->m_Name, Tech->m_Id);
 		}
-		else
+
+		if (shaderWasPatched)
+		{
+			{
+				LoadStatistics::ScopedPhaseTimer timer(LoadStatistics::Phase::Fingerprint);
+				patchedFingerprint = D3DPipelineStateStream::ComputeFingerprint(streamCopy.GetDesc(), rootSignatureData);
+			}
+
+			LoadStatistics::ScopedPhaseTimer timer(LoadStatistics::Phase::LibraryLoad);
+
+			if (patchedFingerprint && PipelineWarmup::TakePipeline(Tech->m_Id, *patchedFingerprint, PipelineState))
+			{
+				shaderWasLoadedFromCache = true;
+				shaderWasWarmed = true;
+			}
+			else if (patchedFingerprint &&
+					 SUCCEEDED(PatchedPipelineLibrary::Load(Tech->m_Id, *patchedFingerprint, streamCopy.GetDesc(), Riid, PipelineState)))
+			{
+				shaderWasLoadedFromCache = true;
+			}
+
+			// The vanilla pipeline can stand in while the patched one compiles, unless the root signature changed.
+			// Command lists would be bound with a signature the vanilla shaders don't match.
+			compileInBackground = !shaderWasLoadedFromCache && Plugin::AsyncPatchedPipelines &&
+								  rootSignatureData.data() == Tech->m_Inputs->m_RootSignatureBlob;
+		}
+
+		// Another thread may already be compiling the exact same pipeline. Share its result instead of doing the
+		// work twice. Followers that get a failure compile on their own below. Background compiles never wait here
+		// since the vanilla stand-in has to be returned right away. AsyncPipelineCompiler coalesces those instead.
+		std::optional<InFlightPipelines::Ticket> inFlightTicket;
+		bool shaderWasCoalesced = false;
+
+		if (patchedFingerprint && !shaderWasLoadedFromCache && !compileInBackground)
+		{
+			LoadStatistics::ScopedPhaseTimer timer(LoadStatistics::Phase::PipelineCreation);
+			auto joined = InFlightPipelines::Join(Tech->m_Id, *patchedFingerprint);
+
+			if (auto ticket = std::get_if<InFlightPipelines::Ticket>(&joined))
+			{
+				inFlightTicket.emplace(std::move(*ticket));
+			}
+			else if (auto& result = std::get<InFlightPipelines::Result>(joined); SUCCEEDED(result.first))
+			{
+				*PipelineState = result.second.Detach();
+				shaderWasLoadedFromCache = true;
+				shaderWasCoalesced = true;
+			}
+		}
+
+		// Vanilla pipelines and background compiles both start out with the game's pipeline library
+		const auto pipelineDesc = compileInBackground ? Desc : streamCopy.GetDesc();
+
+		if (!shaderWasPatched || compileInBackground)
 		{
 			if (TLLastRequestedPipelineLibrary && TLLastRequestedShaderTechnique == Tech)
 			{
-				if (SUCCEEDED(TLLastRequestedPipelineLibrary->LoadPipeline(
-					TLLastRequestedPipelineName,
-					streamCopy.GetDesc(),
+				LoadStatistics::ScopedPhaseTimer timer(LoadStatistics::Phase::LibraryLoad);
+
+				const auto hr = TLLastRequestedPipelineLibrary->LoadPipeline(
+					TLLastRequestedPipelineName.c_str(),
+					pipelineDesc,
 					Riid,
-					PipelineState)))
+					PipelineState);
+
+				if (SUCCEEDED(hr))
 					shaderWasLoadedFromCache = true;
 			}
 		}
 
 		TLLastRequestedPipelineLibrary = nullptr;
 		TLLastRequestedShaderTechnique = nullptr;
+
+		// Background compiles can't be stored either. The worker may swap the patched pipeline in before the game gets
+		// to StorePipeline(), which would file it in the game's library under the vanilla name.
 		TLNextShaderTechniqueToSkipCaching = (shaderWasLoadedFromCache || shaderWasPatched) ? Tech : nullptr;
 
 		if (!shaderWasLoadedFromCache)
 		{
-			const auto hr = Thisptr->CreatePipelineState(streamCopy.GetDesc(), Riid, PipelineState);
+			HRESULT hr;
+			{
+				LoadStatistics::ScopedPhaseTimer timer(LoadStatistics::Phase::PipelineCreation);
+				hr = Thisptr->CreatePipelineState(pipelineDesc, Riid, PipelineState);
+			}
+
+			if (inFlightTicket)
+				inFlightTicket->Publish(hr, SUCCEEDED(hr) ? static_cast<ID3D12PipelineState *>(*PipelineState) : nullptr);
 
 			if (FAILED(hr))
 			{
+				LoadStatistics::NotifyPipelineCreated(Tech->m_Id, Tech->m_Name, LoadStatistics::PipelineSource::Failed);
+
 				spdlog::error(
 					"CreatePipelineState failed and returned {:X}. Shader technique: {:X}.",
 					static_cast<uint32_t>(hr),
@@ -182,59 +226,75 @@ namespace D3DHooks
 
 				return hr;
 			}
+
+			if (patchedFingerprint && !compileInBackground)
+			{
+				LoadStatistics::ScopedPhaseTimer timer(LoadStatistics::Phase::LibraryLoad);
+				PatchedPipelineLibrary::Store(Tech->m_Id, *patchedFingerprint, static_cast<ID3D12PipelineState *>(*PipelineState));
+			}
 		}
 
 		// Tech can't be used because it's allocated on the stack and quickly discarded. PipelineState is a
 		// pointer within another TechniqueData struct that's stored in a global array - a suitable alternative.
 		auto globalTech = reinterpret_cast<ptrdiff_t>(PipelineState) - offsetof(CreationRenderer::TechniqueData, m_PipelineState);
 
-		CRHooks::TrackCompiledTechnique(
-			Thisptr,
-			reinterpret_cast<CreationRenderer::TechniqueData *>(globalTech),
-			std::move(streamCopy),
-			shaderWasPatched);
-
+		// Background compiles may swap *PipelineState at any point after being queued
 		DebuggingUtil::SetObjectDebugName(static_cast<ID3D12PipelineState *>(*PipelineState), Tech->m_Name);
-		return S_OK;
-	}
 
-	class CreatePipelineStateHookGen : Xbyak::CodeGenerator
-	{
-	private:
-		const uintptr_t m_TargetAddress;
+		auto source = LoadStatistics::PipelineSource::VanillaCompile;
 
-	public:
-		CreatePipelineStateHookGen(uintptr_t TargetAddress) : m_TargetAddress(TargetAddress)
+		if (compileInBackground)
+			source = LoadStatistics::PipelineSource::BackgroundCompile;
+		else if (shaderWasCoalesced)
+			source = LoadStatistics::PipelineSource::Coalesced;
+		else if (shaderWasWarmed)
+			source = LoadStatistics::PipelineSource::Warmed;
+		else if (shaderWasLoadedFromCache)
+			source = shaderWasPatched ? LoadStatistics::PipelineSource::PatchedLibrary : LoadStatistics::PipelineSource::GameLibrary;
+		else if (shaderWasPatched)
+			source = LoadStatistics::PipelineSource::PatchedCompile;
+
+		if (compileInBackground)
+		{
+			// Retaining the stream for later counts as copying
+			LoadStatistics::ScopedPhaseTimer timer(LoadStatistics::Phase::StreamCopy);
+
+			AsyncPipelineCompiler::Enqueue(
+				Thisptr,
+				reinterpret_cast<CreationRenderer::TechniqueData *>(globalTech),
+				Tech->m_Name,
+				Tech->m_Id,
+				std::move(streamCopy),
+				patchedFingerprint);
+		}
+		else
 		{
-			mov(ptr[rsp + 0x20], r12); // a5: Technique pointer
-			mov(rax, reinterpret_cast<uintptr_t>(&CreatePipelineStateForTechnique));
-			call(rax);
+			LoadStatistics::ScopedPhaseTimer timer(LoadStatistics::Phase::StreamCopy);
 
-			jmp(ptr[rip]);
-			dq(m_TargetAddress + 0x6);
+			CRHooks::TrackCompiledTechnique(
+				Thisptr,
+				reinterpret_cast<CreationRenderer::TechniqueData *>(globalTech),
+				std::move(streamCopy),
+				shaderWasPatched);
 		}
 
-		void Patch()
+		if (patchedFingerprint)
 		{
-			Hooks::WriteJump(m_TargetAddress, getCode());
+			// Desc is still the untouched vanilla stream
+			LoadStatistics::ScopedPhaseTimer timer(LoadStatistics::Phase::StreamCopy);
+			PipelineWarmup::Record(Tech->m_Id, Tech->m_Name, *patchedFingerprint, Desc, vanillaRootSignatureData);
 		}
-	};
 
-	DECLARE_HOOK_TRANSACTION(D3DHooks)
-	{
-		static LoadPipelineHookGen loadPipelineHook(
-			Offsets::Signature("FF 50 68 85 C0 0F 89 ? ? ? ? 49 8B 8F ? ? ? ? 48 8B 01 4C 8B CF 4C 8D"));
-		loadPipelineHook.Patch();
-
-		static StorePipelineHookGen storePipelineHook(Offsets::Signature("FF 50 40 8B D8 85 C0 0F 89 ? ? ? ? 45 33 E4 4C 89 64 24 58"));
-		storePipelineHook.Patch();
+		LoadStatistics::NotifyPipelineCreated(Tech->m_Id, Tech->m_Name, source);
 
-		static CreatePipelineStateHookGen createPipelineStateHook1(
-			Offsets::Signature("FF 90 78 01 00 00 8B D8 41 BD FF FF FF FF 85 C0 0F 89 ? ? ? ? 33 C0"));
-		createPipelineStateHook1.Patch();
+		if (!capturedStream.empty())
+			PipelineCapture::Record(
+				Tech->m_Id,
+				Tech->m_Name,
+				capturedStream,
+				vanillaRootSignatureData,
+				std::chrono::steady_clock::now() - startTime);
 
-		static CreatePipelineStateHookGen createPipelineStateHook2(
-			Offsets::Signature("FF 90 78 01 00 00 8B D8 85 C0 0F 89 ? ? ? ? 4C 89 6C 24 68"));
-		createPipelineStateHook2.Patch();
-	};
+		return S_OK;
+	}
 }
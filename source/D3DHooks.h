@@ -1,5 +1,32 @@
 #pragma once
 
+#include "RE/CreationRenderer.h"
+
 namespace D3DHooks
 {
+	//
+	// Targets of the pipeline creation hooks. Exposed so they can be driven without the game, e.g. against
+	// tests/StubDevice. CreatePipelineStateForTechnique's PipelineState has to point into a TechniqueData that outlives
+	// the pipeline since it's tracked for live updates.
+	//
+	HRESULT LoadPipelineForTechnique(
+		ID3D12PipelineLibrary1 *Thisptr,
+		LPCWSTR Name,
+		const D3D12_PIPELINE_STATE_STREAM_DESC *Desc,
+		REFIID Riid,
+		void **PipelineState,
+		CreationRenderer::TechniqueData *Tech);
+
+	HRESULT StorePipelineForTechnique(
+		ID3D12PipelineLibrary1 *Thisptr,
+		LPCWSTR Name,
+		ID3D12PipelineState *Pipeline,
+		CreationRenderer::TechniqueData *Tech);
+
+	HRESULT CreatePipelineStateForTechnique(
+		ID3D12Device2 *Thisptr,
+		const D3D12_PIPELINE_STATE_STREAM_DESC *Desc,
+		REFIID Riid,
+		void **PipelineState,
+		CreationRenderer::TechniqueData *Tech);
 }
@@ -1,3 +1,5 @@
+#define XXH_STATIC_LINKING_ONLY // Required for stack allocated XXH3_state_t
+#include <xxhash.h>
 #include "D3DPipelineStateStream.h"
 
 namespace D3DPipelineStateStream
@@ -8,231 +10,515 @@ namespace D3DPipelineStateStream
 		m_End = m_Start + Description->SizeInBytes;
 	}
 
-	void Iterator::Advance()
+	class FingerprintBuilder
 	{
-		const auto type = GetObj()->Type;
+	private:
+		XXH3_state_t m_State;
 
-		m_Start += sizeof(D3D12_PTR_PSO_SUBOBJECT::Type);
-		m_Start = reinterpret_cast<uint8_t *>(AlignUp(reinterpret_cast<uintptr_t>(m_Start), GetAlignmentForType(type)));
+	public:
+		FingerprintBuilder()
+		{
+			XXH3_128bits_reset(&m_State);
+		}
 
-		m_Start += GetSizeForType(type);
-		m_Start = reinterpret_cast<uint8_t *>(AlignUp(reinterpret_cast<uintptr_t>(m_Start), alignof(void *)));
-	}
+		void AddBytes(const void *Data, size_t Size)
+		{
+			// Length prefix keeps adjacent variable-length fields from running into each other
+			Add(static_cast<uint64_t>(Data ? Size : 0));
+
+			if (Data && Size > 0)
+				XXH3_128bits_update(&m_State, Data, Size);
+		}
+
+		void AddString(const char *String)
+		{
+			AddBytes(String, String ? strlen(String) : 0);
+		}
 
-	bool Iterator::AtEnd() const
+		template<typename T>
+		requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+		void Add(T Value)
+		{
+			XXH3_128bits_update(&m_State, &Value, sizeof(Value));
+		}
+
+		template<typename... T>
+		requires(sizeof...(T) > 1)
+		void Add(T... Values)
+		{
+			(Add(Values), ...);
+		}
+
+		Fingerprint Finish() const
+		{
+			const auto digest = XXH3_128bits_digest(&m_State);
+			return { digest.low64, digest.high64 };
+		}
+	};
+
+	void AddDepthStencilOp(FingerprintBuilder& Builder, const D3D12_DEPTH_STENCILOP_DESC& Desc)
 	{
-		return m_Start >= m_End;
+		Builder.Add(Desc.StencilFailOp, Desc.StencilDepthFailOp, Desc.StencilPassOp, Desc.StencilFunc);
 	}
 
-	Iterator::D3D12_PTR_PSO_SUBOBJECT *Iterator::GetObj() const
+	template<typename T>
+	void AddDepthStencil(FingerprintBuilder& Builder, const T& Desc)
 	{
-		return reinterpret_cast<D3D12_PTR_PSO_SUBOBJECT *>(m_Start);
+		Builder.Add(Desc.DepthEnable, Desc.DepthWriteMask, Desc.DepthFunc, Desc.StencilEnable, Desc.StencilReadMask, Desc.StencilWriteMask);
+		AddDepthStencilOp(Builder, Desc.FrontFace);
+		AddDepthStencilOp(Builder, Desc.BackFace);
 	}
 
-	size_t Iterator::GetSizeForType(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type) const
+	std::optional<Fingerprint> ComputeFingerprint(const D3D12_PIPELINE_STATE_STREAM_DESC *Description, std::span<const uint8_t> RootSignatureData)
 	{
-		switch (Type)
-		{
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS:
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS:
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS:
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS:
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS:
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS:
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS:
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS:
-			return sizeof(D3D12_SHADER_BYTECODE);
+		FingerprintBuilder builder;
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO:
-			return sizeof(D3D12_CACHED_PIPELINE_STATE);
+		const bool walkedWholeStream = ForEachSubobject(
+			Description,
+			[&](auto Type, const auto& Payload)
+			{
+				using Payload_t = std::remove_cvref_t<decltype(Payload)>;
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE:
-			return sizeof(ID3D12RootSignature *);
+				// Cached blobs are derived data. They don't change what the pipeline does.
+				if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO)
+					return;
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT:
-			return sizeof(D3D12_STREAM_OUTPUT_DESC);
+				builder.Add(decltype(Type)::value);
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_BLEND:
-			return sizeof(D3D12_BLEND_DESC);
+				if constexpr (IsShaderSubobjectType(Type))
+				{
+					builder.AddBytes(Payload.pShaderBytecode, Payload.BytecodeLength);
+				}
+				else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE)
+				{
+					builder.AddBytes(RootSignatureData.data(), RootSignatureData.size());
+				}
+				else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT)
+				{
+					builder.Add(Payload.NumEntries, Payload.NumStrides, Payload.RasterizedStream);
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_MASK:
-			return sizeof(UINT);
+					for (UINT i = 0; Payload.pSODeclaration && i < Payload.NumEntries; i++)
+					{
+						const auto& entry = Payload.pSODeclaration[i];
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RASTERIZER:
-			return sizeof(D3D12_RASTERIZER_DESC);
+						builder.AddString(entry.SemanticName);
+						builder.Add(entry.Stream, entry.SemanticIndex, entry.StartComponent, entry.ComponentCount, entry.OutputSlot);
+					}
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL:
-			return sizeof(D3D12_DEPTH_STENCIL_DESC);
+					builder.AddBytes(Payload.pBufferStrides, Payload.NumStrides * sizeof(UINT));
+				}
+				else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT)
+				{
+					builder.Add(Payload.NumElements);
+
+					for (UINT i = 0; Payload.pInputElementDescs && i < Payload.NumElements; i++)
+					{
+						const auto& element = Payload.pInputElementDescs[i];
+
+						builder.AddString(element.SemanticName);
+						builder.Add(
+							element.SemanticIndex,
+							element.Format,
+							element.InputSlot,
+							element.AlignedByteOffset,
+							element.InputSlotClass,
+							element.InstanceDataStepRate);
+					}
+				}
+				else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VIEW_INSTANCING)
+				{
+					builder.Add(Payload.Flags);
+					builder.AddBytes(Payload.pViewInstanceLocations, Payload.ViewInstanceCount * sizeof(D3D12_VIEW_INSTANCE_LOCATION));
+				}
+				else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_BLEND)
+				{
+					// RenderTargetWriteMask is followed by padding
+					builder.Add(Payload.AlphaToCoverageEnable, Payload.IndependentBlendEnable);
+
+					for (const auto& target : Payload.RenderTarget)
+					{
+						builder.Add(
+							target.BlendEnable,
+							target.LogicOpEnable,
+							target.SrcBlend,
+							target.DestBlend,
+							target.BlendOp,
+							target.SrcBlendAlpha,
+							target.DestBlendAlpha,
+							target.BlendOpAlpha,
+							target.LogicOp,
+							target.RenderTargetWriteMask);
+					}
+				}
+				else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL)
+				{
+					AddDepthStencil(builder, Payload);
+				}
+				else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL1)
+				{
+					AddDepthStencil(builder, Payload);
+					builder.Add(Payload.DepthBoundsTestEnable);
+				}
+				else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RENDER_TARGET_FORMATS)
+				{
+					// Slots past NumRenderTargets are ignored by the runtime
+					const auto count = std::min<UINT>(Payload.NumRenderTargets, static_cast<UINT>(std::size(Payload.RTFormats)));
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT:
-			return sizeof(D3D12_INPUT_LAYOUT_DESC);
+					builder.Add(count);
+					builder.AddBytes(Payload.RTFormats, count * sizeof(DXGI_FORMAT));
+				}
+				else
+				{
+					// Everything else is plain data without pointers or padding
+					static_assert(std::has_unique_object_representations_v<Payload_t> || std::is_same_v<Payload_t, D3D12_RASTERIZER_DESC>);
+					builder.AddBytes(&Payload, sizeof(Payload));
+				}
+			});
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_IB_STRIP_CUT_VALUE:
-			return sizeof(D3D12_INDEX_BUFFER_STRIP_CUT_VALUE);
+		if (!walkedWholeStream)
+			return std::nullopt;
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PRIMITIVE_TOPOLOGY:
-			return sizeof(D3D12_PRIMITIVE_TOPOLOGY_TYPE);
+		return builder.Finish();
+	}
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RENDER_TARGET_FORMATS:
-			return sizeof(D3D12_RT_FORMAT_ARRAY);
+	// Semantic names hang off of the arrays reported by ForEachReferencedBuffer() and need a second pass
+	template<typename Callback>
+	void ForEachSemanticName(auto Type, auto& Payload, Callback&& Function)
+	{
+		const auto forEachName = [&]<typename T>(const T *Array, size_t Count)
+		{
+			for (size_t i = 0; Array && i < Count; i++)
+				Function(const_cast<T *>(Array)[i].SemanticName);
+		};
+
+		if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT)
+			forEachName(Payload.pSODeclaration, Payload.NumEntries);
+		else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT)
+			forEachName(Payload.pInputElementDescs, Payload.NumElements);
+	}
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL_FORMAT:
-			return sizeof(DXGI_FORMAT);
+	Copy::Copy(const D3D12_PIPELINE_STATE_STREAM_DESC *Description)
+	{
+		CreateCopy(Description, false);
+	}
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_DESC:
-			return sizeof(DXGI_SAMPLE_DESC);
+	Copy::Copy(Copy&& Other)
+	{
+		m_Arena = std::move(Other.m_Arena);
+		m_ArenaSize = std::exchange(Other.m_ArenaSize, 0);
+		m_ArenaUsed = std::exchange(Other.m_ArenaUsed, 0);
+		m_SharedBuffers = std::move(Other.m_SharedBuffers);
+		m_SharedRanges = std::move(Other.m_SharedRanges);
+		m_RefCountedObjects = std::move(Other.m_RefCountedObjects);
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_NODE_MASK:
-			return sizeof(UINT);
+		m_CopiedDesc = Other.m_CopiedDesc;
+		Other.m_CopiedDesc = {};
+		m_Retained = std::exchange(Other.m_Retained, false);
+	}
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_FLAGS:
-			return sizeof(D3D12_PIPELINE_STATE_FLAGS);
+	void Copy::Retain()
+	{
+		// Cached PSO blobs can be megabytes in size and they're useless once anything is patched
+		ForEachSubobject(
+			GetDesc(),
+			[](auto Type, auto& Payload)
+			{
+				if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO)
+				{
+					Payload.pCachedBlob = nullptr;
+					Payload.CachedBlobSizeInBytes = 0;
+				}
+			});
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL1:
-			return sizeof(D3D12_DEPTH_STENCIL_DESC1);
+		// Rebuild from the current stream. The old arena has to stay alive until everything is copied out of it.
+		const auto oldArena = std::move(m_Arena);
+		const auto oldDesc = m_CopiedDesc;
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VIEW_INSTANCING:
-			return sizeof(D3D12_VIEW_INSTANCING_DESC);
-		}
+		m_ArenaSize = 0;
+		m_ArenaUsed = 0;
 
-		std::unreachable();
+		CreateCopy(&oldDesc, true);
 	}
 
-	size_t Iterator::GetAlignmentForType(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type) const
+	void Copy::CreateCopy(const D3D12_PIPELINE_STATE_STREAM_DESC *InputDesc, bool Retaining)
 	{
-		switch (Type)
-		{
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS:
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS:
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS:
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS:
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS:
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS:
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS:
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS:
-			return alignof(D3D12_SHADER_BYTECODE);
+		// One allocation per stream instead of one per pointer. Size everything up front so the arena never grows.
+		m_ArenaSize = GetRequiredArenaSize(InputDesc, Retaining);
+		m_ArenaUsed = 0;
+		m_Arena = std::make_unique_for_overwrite<uint8_t[]>(m_ArenaSize);
+		m_Retained = Retaining;
+
+		// Do a memcpy up front and then patch the pointers as needed
+		m_CopiedDesc.pPipelineStateSubobjectStream = memdup(InputDesc->pPipelineStateSubobjectStream, InputDesc->SizeInBytes);
+		m_CopiedDesc.SizeInBytes = InputDesc->SizeInBytes;
+
+		ForEachSubobject(
+			GetDesc(),
+			[&](auto Type, auto& Payload)
+			{
+				if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE)
+				{
+					if (Payload && !Retaining)
+						TrackObject(CComPtr<ID3D12RootSignature>(Payload));
+				}
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO:
-			return alignof(D3D12_CACHED_PIPELINE_STATE);
+				ForEachReferencedBuffer(
+					Type,
+					Payload,
+					[&](auto& Pointer, size_t Size)
+					{
+						Pointer = CopyIfBorrowed(Pointer, Size, Retaining);
+					});
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE:
-			return alignof(ID3D12RootSignature *);
+				// Arrays were moved into the arena above so their names can be rewritten in place
+				if (Retaining)
+				{
+					ForEachSemanticName(
+						Type,
+						Payload,
+						[&](auto& Name)
+						{
+							Name = Name ? CopyIfBorrowed(Name, strlen(Name) + 1, Retaining) : nullptr;
+						});
+				}
+			});
+	}
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT:
-			return alignof(D3D12_STREAM_OUTPUT_DESC);
+	size_t Copy::GetRequiredArenaSize(const D3D12_PIPELINE_STATE_STREAM_DESC *InputDesc, bool Retaining) const
+	{
+		size_t size = InputDesc->pPipelineStateSubobjectStream ? GetArenaAllocationSize(InputDesc->SizeInBytes) : 0;
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_BLEND:
-			return alignof(D3D12_BLEND_DESC);
+		if (!Retaining)
+			return size;
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_MASK:
-			return alignof(UINT);
+		ForEachSubobject(
+			InputDesc,
+			[&](auto Type, auto& Payload)
+			{
+				ForEachReferencedBuffer(
+					Type,
+					Payload,
+					[&](auto& Pointer, size_t Size)
+					{
+						size += GetCopySize(Pointer, Size, Retaining);
+					});
+
+				ForEachSemanticName(
+					Type,
+					Payload,
+					[&](auto& Name)
+					{
+						size += Name ? GetCopySize(Name, strlen(Name) + 1, Retaining) : 0;
+					});
+			});
+
+		return size;
+	}
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RASTERIZER:
-			return alignof(D3D12_RASTERIZER_DESC);
+	std::vector<uint8_t> Copy::Serialize() const
+	{
+		std::vector<uint8_t> data(sizeof(SerializedStreamHeader));
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL:
-			return alignof(D3D12_DEPTH_STENCIL_DESC);
+		const auto append = [&](const void *Source, size_t Size)
+		{
+			data.resize(GetArenaAllocationSize(data.size()));
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT:
-			return alignof(D3D12_INPUT_LAYOUT_DESC);
+			const auto offset = data.size();
+			data.insert(data.end(), static_cast<const uint8_t *>(Source), static_cast<const uint8_t *>(Source) + Size);
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_IB_STRIP_CUT_VALUE:
-			return alignof(D3D12_INDEX_BUFFER_STRIP_CUT_VALUE);
+			return static_cast<uint64_t>(offset);
+		};
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PRIMITIVE_TOPOLOGY:
-			return alignof(D3D12_PRIMITIVE_TOPOLOGY_TYPE);
+		// Pointer fields are addressed by their offset within the stream since data may move while appending
+		const auto streamStart = static_cast<const uint8_t *>(m_CopiedDesc.pPipelineStateSubobjectStream);
+		const auto streamOffset = append(streamStart, m_CopiedDesc.SizeInBytes);
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RENDER_TARGET_FORMATS:
-			return alignof(D3D12_RT_FORMAT_ARRAY);
+		const auto patchPointer = [&](uint64_t FieldOffset, uint64_t Value)
+		{
+			memcpy(data.data() + FieldOffset, &Value, sizeof(Value));
+		};
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL_FORMAT:
-			return alignof(DXGI_FORMAT);
+		const auto appendPointer = [&](const void *Field, const void *Source, size_t Size)
+		{
+			const auto fieldOffset = streamOffset + (static_cast<const uint8_t *>(Field) - streamStart);
+			const auto dataOffset = Source ? append(Source, Size) : 0;
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_DESC:
-			return alignof(DXGI_SAMPLE_DESC);
+			patchPointer(fieldOffset, dataOffset);
+			return dataOffset;
+		};
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_NODE_MASK:
-			return alignof(UINT);
+		const auto appendStrings = [&]<typename T>(uint64_t ArrayOffset, const T *Array, size_t Count)
+		{
+			for (size_t i = 0; ArrayOffset != 0 && i < Count; i++)
+			{
+				const auto fieldOffset = ArrayOffset + i * sizeof(T) + offsetof(T, SemanticName);
+				const auto name = Array[i].SemanticName;
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_FLAGS:
-			return alignof(D3D12_PIPELINE_STATE_FLAGS);
+				patchPointer(fieldOffset, name ? append(name, strlen(name) + 1) : 0);
+			}
+		};
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL1:
-			return alignof(D3D12_DEPTH_STENCIL_DESC1);
+		ForEachSubobject(
+			GetDesc(),
+			[&](auto Type, const auto& Payload)
+			{
+				if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE)
+				{
+					appendPointer(&Payload, nullptr, 0);
+				}
+				else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT)
+				{
+					const auto declOffset = appendPointer(
+						&Payload.pSODeclaration,
+						Payload.pSODeclaration,
+						Payload.NumEntries * sizeof(D3D12_SO_DECLARATION_ENTRY));
 
-		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VIEW_INSTANCING:
-			return alignof(D3D12_VIEW_INSTANCING_DESC);
-		}
+					appendStrings(declOffset, Payload.pSODeclaration, Payload.NumEntries);
+					appendPointer(&Payload.pBufferStrides, Payload.pBufferStrides, Payload.NumStrides * sizeof(UINT));
+				}
+				else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT)
+				{
+					const auto elementOffset = appendPointer(
+						&Payload.pInputElementDescs,
+						Payload.pInputElementDescs,
+						Payload.NumElements * sizeof(D3D12_INPUT_ELEMENT_DESC));
 
-		std::unreachable();
+					appendStrings(elementOffset, Payload.pInputElementDescs, Payload.NumElements);
+				}
+				else
+				{
+					ForEachReferencedBuffer(
+						Type,
+						Payload,
+						[&](const auto& Pointer, size_t Size)
+						{
+							appendPointer(&Pointer, Pointer, Size);
+						});
+				}
+			});
+
+		const SerializedStreamHeader header {
+			.Magic = SerializedStreamMagic,
+			.Version = SerializedStreamVersion,
+			.TotalSize = data.size(),
+			.StreamOffset = streamOffset,
+			.StreamSize = m_CopiedDesc.SizeInBytes,
+		};
+
+		memcpy(data.data(), &header, sizeof(header));
+		return data;
 	}
 
-	Copy::Copy(const D3D12_PIPELINE_STATE_STREAM_DESC *Description)
+	std::optional<Copy> Copy::Deserialize(std::span<const uint8_t> Data)
 	{
-		CreateCopy(Description);
-	}
+		if (Data.size() < sizeof(SerializedStreamHeader))
+			return std::nullopt;
 
-	Copy::Copy(Copy&& Other)
-	{
-		m_TempBuffers = std::move(Other.m_TempBuffers);
-		m_RefCountedObjects = std::move(Other.m_RefCountedObjects);
+		SerializedStreamHeader header;
+		memcpy(&header, Data.data(), sizeof(header));
 
-		m_CopiedDesc = Other.m_CopiedDesc;
-		Other.m_CopiedDesc = {};
-	}
+		if (header.Magic != SerializedStreamMagic || header.Version != SerializedStreamVersion || header.TotalSize != Data.size())
+			return std::nullopt;
 
-	void Copy::CreateCopy(const D3D12_PIPELINE_STATE_STREAM_DESC *InputDesc)
-	{
-		// Do a memcpy up front and then patch the pointers as needed
-		m_CopiedDesc.pPipelineStateSubobjectStream = memdup(InputDesc->pPipelineStateSubobjectStream, InputDesc->SizeInBytes);
-		m_CopiedDesc.SizeInBytes = InputDesc->SizeInBytes;
+		if (header.StreamOffset < sizeof(header) || header.StreamOffset % alignof(std::max_align_t) != 0 ||
+			header.StreamSize > Data.size() - header.StreamOffset)
+			return std::nullopt;
+
+		// One allocation for everything. Offsets are turned back into pointers in place.
+		Copy copy;
+		copy.m_ArenaSize = Data.size();
+		copy.m_ArenaUsed = Data.size();
+		copy.m_Arena = std::make_unique_for_overwrite<uint8_t[]>(Data.size());
+		copy.m_Retained = true;
+		memcpy(copy.m_Arena.get(), Data.data(), Data.size());
+
+		copy.m_CopiedDesc.pPipelineStateSubobjectStream = copy.m_Arena.get() + header.StreamOffset;
+		copy.m_CopiedDesc.SizeInBytes = header.StreamSize;
 
-		for (Iterator iter(GetDesc()); !iter.AtEnd(); iter.Advance())
+		const auto base = copy.m_Arena.get();
+		const auto streamEnd = base + header.StreamOffset + header.StreamSize;
+		bool valid = true;
+
+		const auto relocate = [&]<typename T>(T *& Pointer, size_t Size)
 		{
-			switch (auto obj = iter.GetObj(); obj->Type)
+			uint64_t offset = 0;
+			memcpy(&offset, &Pointer, sizeof(offset));
+
+			if (offset != 0 && (offset < header.StreamOffset || offset > Data.size() || Size > Data.size() - offset))
 			{
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS:
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS:
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS:
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS:
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS:
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS:
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS:
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS:
-				obj->Shader.pShaderBytecode = memdup(obj->Shader.pShaderBytecode, obj->Shader.BytecodeLength);
-				break;
-
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO:
-				obj->CachedPSO.pCachedBlob = memdup(obj->CachedPSO.pCachedBlob, obj->CachedPSO.CachedBlobSizeInBytes);
-				break;
-
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE:
-				if (obj->RootSignature)
-				{
-					CComPtr<ID3D12RootSignature> rsCopy(obj->RootSignature);
-					TrackObject(std::move(rsCopy));
-				}
-				break;
-
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT:
-				obj->StreamOutput.pSODeclaration = memdup(
-					obj->StreamOutput.pSODeclaration,
-					obj->StreamOutput.NumEntries * sizeof(D3D12_SO_DECLARATION_ENTRY));
-				obj->StreamOutput.pBufferStrides = memdup(obj->StreamOutput.pBufferStrides, obj->StreamOutput.NumStrides * sizeof(UINT));
-				break;
-
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT:
-				obj->InputLayout.pInputElementDescs = memdup(
-					obj->InputLayout.pInputElementDescs,
-					obj->InputLayout.NumElements * sizeof(D3D12_INPUT_ELEMENT_DESC));
-				break;
-
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VIEW_INSTANCING:
-				obj->ViewInstancing.pViewInstanceLocations = memdup(
-					obj->ViewInstancing.pViewInstanceLocations,
-					obj->ViewInstancing.ViewInstanceCount * sizeof(D3D12_VIEW_INSTANCE_LOCATION));
-				break;
+				valid = false;
+				offset = 0;
 			}
-		}
+
+			Pointer = offset ? reinterpret_cast<T *>(base + offset) : nullptr;
+		};
+
+		const auto relocateStrings = [&]<typename T>(const T *Array, size_t Count)
+		{
+			for (size_t i = 0; Array && i < Count; i++)
+			{
+				auto& name = const_cast<T *>(Array)[i].SemanticName;
+				relocate(name, 0);
+
+				if (name && !memchr(name, '\0', base + Data.size() - reinterpret_cast<const uint8_t *>(name)))
+				{
+					valid = false;
+					name = nullptr;
+				}
+			}
+		};
+
+		const bool walkedWholeStream = ForEachSubobject(
+			copy.GetDesc(),
+			[&](auto Type, auto& Payload)
+			{
+				if (reinterpret_cast<uint8_t *>(&Payload) + sizeof(Payload) > streamEnd)
+				{
+					valid = false;
+					return;
+				}
+
+				if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE)
+				{
+					Payload = nullptr;
+				}
+				else
+				{
+					ForEachReferencedBuffer(
+						Type,
+						Payload,
+						[&](auto& Pointer, size_t Size)
+						{
+							relocate(Pointer, Size);
+						});
+
+					if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT)
+						relocateStrings(Payload.pSODeclaration, Payload.NumEntries);
+					else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT)
+						relocateStrings(Payload.pInputElementDescs, Payload.NumElements);
+				}
+			});
+
+		if (!walkedWholeStream || !valid)
+			return std::nullopt;
+
+		return copy;
+	}
+
+	bool Copy::IsOwned(const void *Data) const
+	{
+		// Replacement blobs are kept alive through m_SharedBuffers and never need to be copied
+		const auto address = static_cast<const uint8_t *>(Data);
+
+		if (m_Arena && address >= m_Arena.get() && address < m_Arena.get() + m_ArenaSize)
+			return true;
+
+		return std::any_of(
+			m_SharedRanges.begin(),
+			m_SharedRanges.end(),
+			[&](const auto& Range)
+			{
+				return address >= Range.data() && address < Range.data() + Range.size();
+			});
 	}
 }
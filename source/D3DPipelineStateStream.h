@@ -4,73 +4,289 @@
 
 namespace D3DPipelineStateStream
 {
-	// Thanks to RenderDoc source code for providing some insight. What a mess this was...
 	//
-	// NOTE: D3DX12ParsePipelineStream is close to what I want. However, what I don't want
-	// is to have to implement five billion interface callbacks.
-	class Iterator
+	// Compile-time mapping of subobject types to their payloads. Types without a specialization are unknown to
+	// this build. Their size can't be determined, so walking a stream stops at the first one encountered.
+	//
+	template<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type>
+	struct SubobjectPayload
 	{
-	private:
-		struct D3D12_PSO_SUBOBJECT
+		using type = void;
+	};
+
+#define DEFINE_SUBOBJECT_PAYLOAD(Type, Payload)                         \
+	template<>                                                          \
+	struct SubobjectPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_##Type> \
+	{                                                                   \
+		using type = Payload;                                           \
+	};
+
+	DEFINE_SUBOBJECT_PAYLOAD(ROOT_SIGNATURE, ID3D12RootSignature *)
+	DEFINE_SUBOBJECT_PAYLOAD(VS, D3D12_SHADER_BYTECODE)
+	DEFINE_SUBOBJECT_PAYLOAD(PS, D3D12_SHADER_BYTECODE)
+	DEFINE_SUBOBJECT_PAYLOAD(DS, D3D12_SHADER_BYTECODE)
+	DEFINE_SUBOBJECT_PAYLOAD(HS, D3D12_SHADER_BYTECODE)
+	DEFINE_SUBOBJECT_PAYLOAD(GS, D3D12_SHADER_BYTECODE)
+	DEFINE_SUBOBJECT_PAYLOAD(CS, D3D12_SHADER_BYTECODE)
+	DEFINE_SUBOBJECT_PAYLOAD(STREAM_OUTPUT, D3D12_STREAM_OUTPUT_DESC)
+	DEFINE_SUBOBJECT_PAYLOAD(BLEND, D3D12_BLEND_DESC)
+	DEFINE_SUBOBJECT_PAYLOAD(SAMPLE_MASK, UINT)
+	DEFINE_SUBOBJECT_PAYLOAD(RASTERIZER, D3D12_RASTERIZER_DESC)
+	DEFINE_SUBOBJECT_PAYLOAD(DEPTH_STENCIL, D3D12_DEPTH_STENCIL_DESC)
+	DEFINE_SUBOBJECT_PAYLOAD(INPUT_LAYOUT, D3D12_INPUT_LAYOUT_DESC)
+	DEFINE_SUBOBJECT_PAYLOAD(IB_STRIP_CUT_VALUE, D3D12_INDEX_BUFFER_STRIP_CUT_VALUE)
+	DEFINE_SUBOBJECT_PAYLOAD(PRIMITIVE_TOPOLOGY, D3D12_PRIMITIVE_TOPOLOGY_TYPE)
+	DEFINE_SUBOBJECT_PAYLOAD(RENDER_TARGET_FORMATS, D3D12_RT_FORMAT_ARRAY)
+	DEFINE_SUBOBJECT_PAYLOAD(DEPTH_STENCIL_FORMAT, DXGI_FORMAT)
+	DEFINE_SUBOBJECT_PAYLOAD(SAMPLE_DESC, DXGI_SAMPLE_DESC)
+	DEFINE_SUBOBJECT_PAYLOAD(NODE_MASK, UINT)
+	DEFINE_SUBOBJECT_PAYLOAD(CACHED_PSO, D3D12_CACHED_PIPELINE_STATE)
+	DEFINE_SUBOBJECT_PAYLOAD(FLAGS, D3D12_PIPELINE_STATE_FLAGS)
+	DEFINE_SUBOBJECT_PAYLOAD(DEPTH_STENCIL1, D3D12_DEPTH_STENCIL_DESC1)
+	DEFINE_SUBOBJECT_PAYLOAD(VIEW_INSTANCING, D3D12_VIEW_INSTANCING_DESC)
+	DEFINE_SUBOBJECT_PAYLOAD(AS, D3D12_SHADER_BYTECODE)
+	DEFINE_SUBOBJECT_PAYLOAD(MS, D3D12_SHADER_BYTECODE)
+
+#undef DEFINE_SUBOBJECT_PAYLOAD
+
+	// Upper bound for lookup tables. Any type value at or above this is treated as unknown.
+	constexpr size_t SubobjectTypeLimit = 32;
+
+	struct SubobjectLayout
+	{
+		uint32_t Size = 0; // Zero for unknown types
+		uint32_t Alignment = 0;
+	};
+
+	constexpr auto SubobjectLayouts = []<size_t... I>(std::index_sequence<I...>)
+	{
+		const auto getLayout = []<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type>() -> SubobjectLayout
 		{
-			D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type;
+			using Payload = SubobjectPayload<Type>::type;
+
+			if constexpr (std::is_void_v<Payload>)
+				return {};
+			else
+				return { sizeof(Payload), alignof(Payload) };
 		};
 
-		struct D3D12_PTR_PSO_SUBOBJECT
+		return std::array { getLayout.template operator()<static_cast<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE>(I)>()... };
+	}(std::make_index_sequence<SubobjectTypeLimit>());
+
+	constexpr bool IsKnownSubobjectType(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type)
+	{
+		return static_cast<size_t>(Type) < SubobjectTypeLimit && SubobjectLayouts[Type].Size != 0;
+	}
+
+	constexpr bool IsShaderSubobjectType(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type)
+	{
+		switch (Type)
 		{
-			D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type;
-			UINT Padding;
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS:
+		case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS:
+			return true;
 
-			union
-			{
-				ID3D12RootSignature *RootSignature;
-				D3D12_SHADER_BYTECODE Shader;
-				D3D12_STREAM_OUTPUT_DESC StreamOutput;
-				D3D12_INPUT_LAYOUT_DESC InputLayout;
-				D3D12_CACHED_PIPELINE_STATE CachedPSO;
-				D3D12_VIEW_INSTANCING_DESC ViewInstancing;
-			};
-		};
+		default:
+			return false;
+		}
+	}
 
+	// Thanks to RenderDoc source code for providing some insight. What a mess this was...
+	//
+	// NOTE: D3DX12ParsePipelineStream is close to what I want. However, what I don't want
+	// is to have to implement five billion interface callbacks.
+	class Iterator
+	{
+	private:
 		uint8_t *m_Start = nullptr;
 		uint8_t *m_End = nullptr;
+		bool m_FoundUnknownType = false;
 
 	public:
 		Iterator(const D3D12_PIPELINE_STATE_STREAM_DESC *Description);
 		Iterator(const Iterator& Other) = delete;
 		Iterator& operator=(const Iterator& Other) = delete;
 
-		void Advance();
+		void Advance()
+		{
+			const auto& layout = SubobjectLayouts[GetType()];
 
-		bool AtEnd() const;
-		D3D12_PTR_PSO_SUBOBJECT *GetObj() const;
+			m_Start = AlignUp(m_Start + sizeof(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE), layout.Alignment) + layout.Size;
+			m_Start = AlignUp(m_Start, alignof(void *));
+		}
 
-		size_t GetSizeForType(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type) const;
-		size_t GetAlignmentForType(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type) const;
+		bool AtEnd()
+		{
+			if (m_Start >= m_End)
+				return true;
+
+			if (!IsKnownSubobjectType(GetType()))
+			{
+				m_FoundUnknownType = true;
+				return true;
+			}
+
+			return false;
+		}
+
+		bool FoundUnknownType() const
+		{
+			return m_FoundUnknownType;
+		}
+
+		D3D12_PIPELINE_STATE_SUBOBJECT_TYPE GetType() const
+		{
+			return *reinterpret_cast<const D3D12_PIPELINE_STATE_SUBOBJECT_TYPE *>(m_Start);
+		}
+
+		void *GetPayload() const
+		{
+			return AlignUp(m_Start + sizeof(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE), SubobjectLayouts[GetType()].Alignment);
+		}
 
 	private:
-		template<typename T>
-		static T AlignUp(T X, T A)
+		static uint8_t *AlignUp(uint8_t *X, uintptr_t A)
 		{
-			return (X + (A - 1)) & (~(A - 1));
+			return reinterpret_cast<uint8_t *>((reinterpret_cast<uintptr_t>(X) + (A - 1)) & (~(A - 1)));
 		}
 	};
 
+	//
+	// Calls Callback(Type, Payload&) for each subobject where Type is a std::integral_constant. Payload is typed
+	// according to SubobjectPayload<Type>, so callers can branch with if constexpr instead of switching at runtime.
+	// Returns false if the stream contains a subobject type that isn't known to this build. Walking stops there.
+	//
+	template<typename Visitor>
+	bool ForEachSubobject(const D3D12_PIPELINE_STATE_STREAM_DESC *Description, Visitor&& Callback)
+	{
+		using Thunk = void (*)(Visitor&, void *);
+
+		constexpr auto thunks = []<size_t... I>(std::index_sequence<I...>)
+		{
+			const auto getThunk = []<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type>() -> Thunk
+			{
+				using Payload = SubobjectPayload<Type>::type;
+
+				if constexpr (std::is_void_v<Payload>)
+					return nullptr;
+				else
+					return [](Visitor& Callback, void *Data)
+					{
+						Callback(std::integral_constant<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE, Type>(), *static_cast<Payload *>(Data));
+					};
+			};
+
+			return std::array { getThunk.template operator()<static_cast<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE>(I)>()... };
+		}(std::make_index_sequence<SubobjectTypeLimit>());
+
+		Iterator iter(Description);
+
+		for (; !iter.AtEnd(); iter.Advance())
+			thunks[iter.GetType()](Callback, iter.GetPayload());
+
+		return !iter.FoundUnknownType();
+	}
+
+	//
+	// Calls Callback(Pointer&, Size) for every buffer a subobject payload points to
+	//
+	template<typename Callback>
+	void ForEachReferencedBuffer(auto Type, auto& Payload, Callback&& Function)
+	{
+		if constexpr (IsShaderSubobjectType(Type))
+		{
+			Function(Payload.pShaderBytecode, Payload.BytecodeLength);
+		}
+		else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO)
+		{
+			Function(Payload.pCachedBlob, Payload.CachedBlobSizeInBytes);
+		}
+		else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT)
+		{
+			Function(Payload.pSODeclaration, Payload.NumEntries * sizeof(D3D12_SO_DECLARATION_ENTRY));
+			Function(Payload.pBufferStrides, Payload.NumStrides * sizeof(UINT));
+		}
+		else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT)
+		{
+			Function(Payload.pInputElementDescs, Payload.NumElements * sizeof(D3D12_INPUT_ELEMENT_DESC));
+		}
+		else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VIEW_INSTANCING)
+		{
+			Function(Payload.pViewInstanceLocations, Payload.ViewInstanceCount * sizeof(D3D12_VIEW_INSTANCE_LOCATION));
+		}
+	}
+
+	struct Fingerprint
+	{
+		uint64_t Low = 0;
+		uint64_t High = 0;
+
+		bool operator==(const Fingerprint&) const = default;
+	};
+
+	// Stable 128-bit hash of everything a stream describes, including pointed-to data. Pointer values, padding
+	// and cached PSO blobs are ignored so identical streams from different allocations match. Root signature
+	// objects are opaque and have to be described by their serialized blob instead. Returns std::nullopt if the
+	// stream contains subobject types unknown to this build.
+	std::optional<Fingerprint> ComputeFingerprint(
+		const D3D12_PIPELINE_STATE_STREAM_DESC *Description,
+		std::span<const uint8_t> RootSignatureData = {});
+
+	//
+	// Flat, relocatable form of a stream. Every pointer is replaced by an offset from the start of the buffer and
+	// zero stays null. All values are little endian.
+	//
+	// [SerializedStreamHeader]
+	// [Subobject stream]
+	// [Referenced data]	Shaders, input layouts, semantic names, etc. Each starts on a 16 byte boundary.
+	//
+	constexpr uint32_t SerializedStreamMagic = 0x53505353; // "SSPS"
+	constexpr uint32_t SerializedStreamVersion = 1;
+
+	struct SerializedStreamHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t TotalSize;
+		uint64_t StreamOffset;
+		uint64_t StreamSize;
+	};
+	static_assert(sizeof(SerializedStreamHeader) == 0x20);
+
+	// Copies are lazy. Only the subobject stream itself is duplicated since patching rewrites pointers inside of
+	// it. Shaders, input layouts, and other referenced buffers stay in the caller's memory until Retain() is used.
 	class Copy
 	{
 	private:
-		std::vector<std::unique_ptr<uint8_t[]>> m_TempBuffers;
+		std::unique_ptr<uint8_t[]> m_Arena; // Holds the copied stream and, once retained, everything it points to
+		size_t m_ArenaSize = 0;
+		size_t m_ArenaUsed = 0;
+		std::vector<std::shared_ptr<const void>> m_SharedBuffers;
+		std::vector<std::span<const uint8_t>> m_SharedRanges;
 		std::vector<CComPtr<IUnknown>> m_RefCountedObjects;
 		D3D12_PIPELINE_STATE_STREAM_DESC m_CopiedDesc = {};
+		bool m_Retained = false;
 
 	public:
 		Copy(const D3D12_PIPELINE_STATE_STREAM_DESC *Description);
 		Copy(const Copy& Other) = delete;
 		Copy(Copy&& Other);
 
-		void TrackAllocation(std::unique_ptr<uint8_t[]>&& Allocation)
+		// Take ownership of every buffer the stream still borrows from the caller. Cached PSO blobs are dropped
+		// instead since retained streams are only ever used to create pipelines from scratch.
+		void Retain();
+
+		template<typename T>
+		void TrackSharedData(std::shared_ptr<T> Data, std::span<const uint8_t> Range)
 		{
-			m_TempBuffers.emplace_back(std::forward<std::unique_ptr<uint8_t[]>>(Allocation));
+			m_SharedBuffers.emplace_back(std::move(Data));
+			m_SharedRanges.emplace_back(Range);
 		}
 
 		template<typename T>
@@ -84,8 +300,53 @@ namespace D3DPipelineStateStream
 			return &m_CopiedDesc;
 		}
 
+		size_t GetArenaSize() const
+		{
+			return m_ArenaSize;
+		}
+
+		// True once nothing is borrowed from the caller anymore, either through Retain() or Deserialize()
+		bool IsRetained() const
+		{
+			return m_Retained;
+		}
+
+		// True if Data lives in the arena or in a buffer registered through TrackSharedData()
+		bool IsOwned(const void *Data) const;
+
+		// Root signature objects can't be serialized and come back as null. Callers have to recreate them from
+		// the serialized root signature blob.
+		std::vector<uint8_t> Serialize() const;
+		static std::optional<Copy> Deserialize(std::span<const uint8_t> Data);
+
 	private:
-		void CreateCopy(const D3D12_PIPELINE_STATE_STREAM_DESC *InputDesc);
+		Copy() = default;
+
+		void CreateCopy(const D3D12_PIPELINE_STATE_STREAM_DESC *InputDesc, bool Retaining);
+		size_t GetRequiredArenaSize(const D3D12_PIPELINE_STATE_STREAM_DESC *InputDesc, bool Retaining) const;
+
+		static size_t GetArenaAllocationSize(size_t Size)
+		{
+			// Every allocation keeps the strictest fundamental alignment
+			return (Size + (alignof(std::max_align_t) - 1)) & ~(alignof(std::max_align_t) - 1);
+		}
+
+		size_t GetCopySize(const void *Data, size_t Size, bool Retaining) const
+		{
+			if (!Retaining || !Data || IsOwned(Data))
+				return 0;
+
+			return GetArenaAllocationSize(Size);
+		}
+
+		template<typename T>
+		T *CopyIfBorrowed(T *Data, size_t Size, bool Retaining)
+		{
+			if (GetCopySize(Data, Size, Retaining) == 0)
+				return Data;
+
+			return memdup(Data, Size);
+		}
 
 		template<typename T>
 		T *memdup(const T *Data, size_t Size)
@@ -93,8 +354,16 @@ namespace D3DPipelineStateStream
 			if (!Data)
 				return nullptr;
 
-			auto& ptr = m_TempBuffers.emplace_back(std::make_unique<uint8_t[]>(Size));
-			return reinterpret_cast<T *>(memcpy(ptr.get(), Data, Size));
+			const auto allocationSize = GetArenaAllocationSize(Size);
+
+			// GetRequiredArenaSize() and CreateCopy() are out of sync
+			if (m_ArenaUsed + allocationSize > m_ArenaSize)
+				std::terminate();
+
+			auto ptr = m_Arena.get() + m_ArenaUsed;
+			m_ArenaUsed += allocationSize;
+
+			return reinterpret_cast<T *>(memcpy(ptr, Data, Size));
 		}
 	};
 }
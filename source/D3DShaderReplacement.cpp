@@ -1,29 +1,42 @@
+#include <shared_mutex>
 #include "CComPtr.h"
 #include "D3DPipelineStateStream.h"
 #include "D3DShaderReplacement.h"
 #include "DebuggingUtil.h"
+#include "Hashing.h"
+#include "LoadStatistics.h"
 #include "Plugin.h"
+#include "ReplacementFilter.h"
+#include "ShaderArchive.h"
+#include "ShaderBinIndex.h"
+#include "ShaderBlobCache.h"
+#include "ShaderDumpWriter.h"
 
 namespace D3DShaderReplacement
 {
-	uint32_t FNV1A32(const void *Input, size_t Length)
+	struct OriginalShaderHash
 	{
-		constexpr uint32_t FNV1_PRIME_32 = 0x01000193;
-		constexpr uint32_t FNV1_BASE_32 = 2166136261U;
+		size_t Length = 0;
+		uint64_t Hash = 0;
+	};
 
-		auto data = reinterpret_cast<const unsigned char *>(Input);
-		auto end = data + Length;
+	// Game bytecode never changes for a given technique and stage. Hash it once and keep the result. Only valid
+	// for bytecode the game handed us: retained streams on the live update path may already point at a previous
+	// replacement, and those are compared directly instead.
+	std::shared_mutex OriginalHashLock;
+	std::map<std::pair<uint64_t, uint32_t>, OriginalShaderHash> OriginalHashes;
 
-		auto hash = FNV1_BASE_32;
+	struct CachedRootSignature
+	{
+		ID3D12Device2 *Device; // Kept alive by Signature
+		std::vector<uint8_t> Data;
+		CComPtr<ID3D12RootSignature> Signature;
+	};
 
-		for (; data != end; data++)
-		{
-			hash ^= *data;
-			hash *= FNV1_PRIME_32;
-		}
-
-		return hash;
-	}
+	// Overrides tend to be shared by many techniques. Identical blobs created on the same device map to one root
+	// signature object, which also lets the layout hook skip rebinding it between techniques.
+	std::mutex RootSignatureCacheLock;
+	std::unordered_multimap<uint64_t, CachedRootSignature> RootSignatureCache;
 
 	const std::filesystem::path& GetShaderBinDirectory()
 	{
@@ -41,6 +54,149 @@ namespace D3DShaderReplacement
 		return path;
 	}
 
+	void Initialize()
+	{
+		// Materializing reads the manifest left behind by a previous deduplicated dump
+		if (!Plugin::ShaderDumpBinPath.empty() && !Plugin::ShaderDumpMaterializePath.empty())
+			ShaderDumpWriter::Materialize(Plugin::ShaderDumpBinPath, Plugin::ShaderDumpMaterializePath);
+
+		if (!Plugin::ShaderArchivePackPath.empty())
+			ShaderArchive::PackDirectory(GetShaderBinDirectory(), Plugin::ShaderArchivePackPath);
+
+		// Dumping doesn't read anything back from disk
+		if (!Plugin::ShaderDumpBinPath.empty())
+			return;
+
+		RefreshReplacementSources();
+
+		// Shader loading starts shortly after the device is created. Get every replacement file into memory
+		// before the pipeline creation threads ask for it.
+		std::vector<std::filesystem::path> prefetchPaths;
+
+		ShaderBinIndex::ForEachEntry(
+			[&](uint64_t, std::string_view, const std::filesystem::path& Path)
+			{
+				prefetchPaths.emplace_back(Path);
+			});
+
+		ShaderBlobCache::Prefetch(std::move(prefetchPaths));
+	}
+
+	void RefreshReplacementSources()
+	{
+		const auto start = std::chrono::steady_clock::now();
+		ShaderBinIndex::Build(GetShaderBinDirectory());
+		ShaderArchive::MountAll(GetShaderBinDirectory());
+		ShaderBlobCache::Clear();
+
+		std::vector<uint64_t> filterKeys;
+
+		ShaderBinIndex::ForEachEntry(
+			[&](uint64_t TechniqueId, std::string_view Prefix, const std::filesystem::path&)
+			{
+				filterKeys.emplace_back(ReplacementFilter::Filter::MakeKey(TechniqueId, ShaderArchive::MakeStageTag(Prefix)));
+			});
+
+		ShaderArchive::ForEachEntry(
+			[&](uint64_t TechniqueId, uint32_t Stage)
+			{
+				filterKeys.emplace_back(ReplacementFilter::Filter::MakeKey(TechniqueId, Stage));
+			});
+
+		ReplacementFilter::Build(std::move(filterKeys));
+		const auto end = std::chrono::steady_clock::now();
+
+		spdlog::info(
+			"Indexed {} custom shader file(s) and {} archived shader(s) in {} ms.",
+			ShaderBinIndex::GetEntryCount(),
+			ShaderArchive::GetEntryCount(),
+			std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+	}
+
+	std::shared_ptr<const ShaderBlobCache::Blob> FindReplacement(const char *TechniqueShortName, uint64_t TechniqueId, const char *Prefix)
+	{
+		// Loose files take priority over archives so individual shaders can be iterated on during development
+		if (const auto path = ShaderBinIndex::Find(TechniqueShortName, TechniqueId, Prefix))
+			return ShaderBlobCache::Acquire(*path);
+
+		return ShaderArchive::Find(TechniqueId, Prefix);
+	}
+
+	uint64_t GetOriginalShaderHash(uint64_t TechniqueId, const char *Prefix, const D3D12_SHADER_BYTECODE& Bytecode)
+	{
+		const auto key = std::make_pair(TechniqueId, ShaderArchive::MakeStageTag(Prefix));
+
+		{
+			std::shared_lock lock(OriginalHashLock);
+
+			if (auto itr = OriginalHashes.find(key); itr != OriginalHashes.end() && itr->second.Length == Bytecode.BytecodeLength)
+				return itr->second.Hash;
+		}
+
+		const auto hash = Hashing::ComputeContentHash(
+			{ static_cast<const uint8_t *>(Bytecode.pShaderBytecode), Bytecode.BytecodeLength });
+
+		std::unique_lock lock(OriginalHashLock);
+		OriginalHashes.insert_or_assign(key, OriginalShaderHash { .Length = Bytecode.BytecodeLength, .Hash = hash });
+
+		return hash;
+	}
+
+	bool IsSameShader(
+		const ShaderBlobCache::Blob& Blob,
+		const D3DPipelineStateStream::Copy& StreamCopy,
+		uint64_t TechniqueId,
+		const char *Prefix,
+		const D3D12_SHADER_BYTECODE& Bytecode)
+	{
+		const auto data = Blob.GetData();
+
+		if (data.size() != Bytecode.BytecodeLength)
+			return false;
+
+		// Anything the stream owns is interned game bytecode or an earlier replacement. Neither is guaranteed to
+		// be the original for this technique.
+		if (!StreamCopy.IsOwned(Bytecode.pShaderBytecode) && Blob.GetHash() != GetOriginalShaderHash(TechniqueId, Prefix, Bytecode))
+			return false;
+
+		// Equal hashes. Only a full compare can rule out a collision.
+		return memcmp(data.data(), Bytecode.pShaderBytecode, data.size()) == 0;
+	}
+
+	HRESULT GetOrCreateRootSignature(ID3D12Device2 *Device, std::span<const uint8_t> Data, CComPtr<ID3D12RootSignature>& Signature)
+	{
+		const auto hash = Hashing::ComputeContentHash(Data);
+		std::scoped_lock lock(RootSignatureCacheLock);
+
+		const auto [begin, end] = RootSignatureCache.equal_range(hash);
+
+		for (auto itr = begin; itr != end; itr++)
+		{
+			if (itr->second.Device == Device && std::ranges::equal(itr->second.Data, Data))
+			{
+				Signature = itr->second.Signature;
+				return S_OK;
+			}
+		}
+
+		// Created under the lock so concurrent requests for the same blob can't end up with different objects
+		LoadStatistics::ScopedPhaseTimer timer(LoadStatistics::Phase::RootSignatureCreation);
+		const auto hr = Device->CreateRootSignature(0, Data.data(), Data.size(), IID_PPV_ARGS(&Signature));
+
+		if (SUCCEEDED(hr))
+		{
+			RootSignatureCache.emplace(
+				hash,
+				CachedRootSignature {
+					.Device = Device,
+					.Data = { Data.begin(), Data.end() },
+					.Signature = Signature,
+				});
+		}
+
+		return hr;
+	}
+
 	const char *GetShaderTypePrefix(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type)
 	{
 		switch (Type)
@@ -75,87 +231,56 @@ namespace D3DShaderReplacement
 		const char *TechniqueName,
 		uint64_t TechniqueId)
 	{
-		// Techniques have to be trimmed as they're too long to be used in file names
 		const auto prefix = GetShaderTypePrefix(Type);
+		const bool dumping = !Plugin::ShaderDumpBinPath.empty();
 
-		char techniqueShortName[512] = {};
-		strncpy_s(techniqueShortName, TechniqueName, _TRUNCATE);
-
-		if (auto s = strchr(techniqueShortName, '-'))
-			*s = '\0';
-
-		char shaderBinFileName[512];
-		sprintf_s(shaderBinFileName, "%s_%llX_%s.bin", techniqueShortName, TechniqueId, prefix);
+		// Nearly every technique lacks an override. Bail before doing any other work.
+		if (!dumping && !ReplacementFilter::MayContain(TechniqueId, ShaderArchive::MakeStageTag(prefix)))
+			return false;
 
-		const auto shaderBinFullPath = GetShaderBinDirectory() / techniqueShortName / shaderBinFileName;
+		// Techniques have to be trimmed as they're too long to be used in file names
+		char techniqueShortName[512] = {};
+		std::string_view(TechniqueName, strcspn(TechniqueName, "-")).copy(techniqueShortName, std::size(techniqueShortName) - 1);
 
-		if (!Plugin::ShaderDumpBinPath.empty())
+		if (dumping)
 		{
-			// Extract it
+			// Extract it. Files are written out asynchronously.
 			if (Bytecode->pShaderBytecode && Bytecode->BytecodeLength != 0)
 			{
-				// Calculate the shader data hash, dump it, then map it to a technique name in a dedicated CSV file. It's
-				// far from efficient but it's usually a one-time operation.
-				std::filesystem::create_directories(shaderBinFullPath.parent_path());
-
-				const auto hash = FNV1A32(Bytecode->pShaderBytecode, Bytecode->BytecodeLength);
-				spdlog::info("Dumping shader with hash {} to {}", hash, shaderBinFullPath.string());
-
-				static std::mutex fileDumpMutex;
-				fileDumpMutex.lock();
-				{
-					// Dump binary
-					if (std::ofstream f(shaderBinFullPath, std::ios::binary); f.good())
-						f.write(reinterpret_cast<const char *>(Bytecode->pShaderBytecode), Bytecode->BytecodeLength);
-
-					// Append to CSV
-					const static auto csvPath = Plugin::ShaderDumpBinPath / "ShaderTechniqueMap.csv";
-
-					if (std::ofstream f(csvPath, std::ios::app); f.good())
-					{
-						char csvLine[2048];
-						auto length = sprintf_s(
-							csvLine,
-							"%s,%s,%u,%llX,\"%s\"\n",
-							techniqueShortName,
-							prefix,
-							hash,
-							TechniqueId,
-							TechniqueName);
-
-						f.write(csvLine, length);
-					}
-				}
-				fileDumpMutex.unlock();
+				ShaderDumpWriter::Enqueue(
+					techniqueShortName,
+					prefix,
+					TechniqueId,
+					TechniqueName,
+					{ static_cast<const uint8_t *>(Bytecode->pShaderBytecode), Bytecode->BytecodeLength });
 			}
 		}
 		else
 		{
-			// Replace it
-			if (std::ifstream f(shaderBinFullPath, std::ios::binary | std::ios::ate); f.good())
-			{
-				static bool once = [&]()
-				{
-					spdlog::info("Trying to replace at least one shader: {}", shaderBinFullPath.string());
-					return true;
-				}();
+			// Replace it. Sources are indexed up front so missing files never hit the disk.
+			const auto blob = FindReplacement(techniqueShortName, TechniqueId, prefix);
 
-				auto fileSize = static_cast<uint64_t>(f.tellg());
-				auto fileData = std::make_unique<uint8_t[]>(fileSize);
+			if (!blob)
+				return false;
 
-				f.seekg(0, std::ios::beg);
-				f.read(reinterpret_cast<char *>(fileData.get()), fileSize);
+			static bool once = [&]()
+			{
+				spdlog::info("Trying to replace at least one shader: {}_{:X}_{}", techniqueShortName, TechniqueId, prefix);
+				return true;
+			}();
 
-				// Only replace if the on-disk data is different
-				if (fileSize != Bytecode->BytecodeLength || memcmp(fileData.get(), Bytecode->pShaderBytecode, fileSize) != 0)
-				{
-					Bytecode->BytecodeLength = fileSize;
-					Bytecode->pShaderBytecode = fileData.get();
-					StreamCopy.TrackAllocation(std::move(fileData));
+			// Only replace if the on-disk data is different. The stream references the shared blob directly
+			// instead of owning a private copy.
+			if (!IsSameShader(*blob, StreamCopy, TechniqueId, prefix, *Bytecode))
+			{
+				const auto data = blob->GetData();
 
-					spdlog::trace("Used file replacement: {}", shaderBinFullPath.string());
-					return true;
-				}
+				Bytecode->BytecodeLength = data.size();
+				Bytecode->pShaderBytecode = data.data();
+				StreamCopy.TrackSharedData(blob, data);
+
+				spdlog::trace("Used replacement: {}_{:X}_{}", techniqueShortName, TechniqueId, prefix);
+				return true;
 			}
 		}
 
@@ -165,79 +290,81 @@ namespace D3DShaderReplacement
 	bool PatchPipelineStateStream(
 		D3DPipelineStateStream::Copy& StreamCopy,
 		ID3D12Device2 *Device,
-		const std::span<const uint8_t> *RootSignatureData,
+		std::span<const uint8_t> *RootSignatureData,
 		const char *TechniqueName,
 		uint64_t TechniqueId)
 	{
 		bool modified = false;
 
-		for (D3DPipelineStateStream::Iterator iter(StreamCopy.GetDesc()); !iter.AtEnd(); iter.Advance())
-		{
-			switch (auto obj = iter.GetObj(); obj->Type)
+		const bool walkedWholeStream = D3DPipelineStateStream::ForEachSubobject(
+			StreamCopy.GetDesc(),
+			[&](auto Type, auto& Payload)
 			{
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS:
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS:
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS:
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS:
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS:
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS:
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS:
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS:
-				if (ExtractOrReplaceShader(StreamCopy, obj->Type, &obj->Shader, TechniqueName, TechniqueId))
-					modified = true;
-				break;
-
-			case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE:
-				if (RootSignatureData)
+				if constexpr (D3DPipelineStateStream::IsShaderSubobjectType(Type))
+				{
+					if (ExtractOrReplaceShader(StreamCopy, Type, &Payload, TechniqueName, TechniqueId))
+						modified = true;
+				}
+				else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE)
 				{
+					if (!RootSignatureData)
+						return;
+
 					D3D12_SHADER_BYTECODE bytecode {
 						.pShaderBytecode = RootSignatureData->data(),
 						.BytecodeLength = RootSignatureData->size(),
 					};
 
-					if (ExtractOrReplaceShader(StreamCopy, obj->Type, &bytecode, TechniqueName, TechniqueId))
+					if (!ExtractOrReplaceShader(StreamCopy, Type, &bytecode, TechniqueName, TechniqueId))
+						return;
+
+					CComPtr<ID3D12RootSignature> newSignature;
+					const auto hr = GetOrCreateRootSignature(
+						Device,
+						{ static_cast<const uint8_t *>(bytecode.pShaderBytecode), bytecode.BytecodeLength },
+						newSignature);
+
+					if (FAILED(hr))
 					{
-						CComPtr<ID3D12RootSignature> newSignature;
-						const auto hr = Device->CreateRootSignature(
-							0,
-							bytecode.pShaderBytecode,
-							bytecode.BytecodeLength,
-							IID_PPV_ARGS(&newSignature));
-
-						if (FAILED(hr))
-						{
-							// Somebody passed in malformed data
-							spdlog::error(
-								"Failed to create root signature: {:X}. Shader technique: {:X}.",
-								static_cast<uint32_t>(hr),
-								TechniqueId);
-						}
-						else
-						{
-							obj->RootSignature = newSignature.Get();
-							StreamCopy.TrackObject(std::move(newSignature));
-
-							modified = true;
-						}
+						// Somebody passed in malformed data
+						spdlog::error(
+							"Failed to create root signature: {:X}. Shader technique: {:X}.",
+							static_cast<uint32_t>(hr),
+							TechniqueId);
+					}
+					else
+					{
+						Payload = newSignature.Get();
+						StreamCopy.TrackObject(std::move(newSignature));
+						*RootSignatureData = { static_cast<const uint8_t *>(bytecode.pShaderBytecode), bytecode.BytecodeLength };
+
+						modified = true;
 					}
 				}
-				break;
-			}
+			});
+
+		if (!walkedWholeStream)
+		{
+			static bool once = [&]()
+			{
+				spdlog::warn("Pipeline stream contains an unknown subobject type. Shader technique: {:X}.", TechniqueId);
+				return true;
+			}();
 		}
 
 		// Loop around once again to disable PSO cache entries
 		if (modified)
 		{
-			for (D3DPipelineStateStream::Iterator iter(StreamCopy.GetDesc()); !iter.AtEnd(); iter.Advance())
-			{
-				switch (auto obj = iter.GetObj(); obj->Type)
+			D3DPipelineStateStream::ForEachSubobject(
+				StreamCopy.GetDesc(),
+				[](auto Type, auto& Payload)
 				{
-				case D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO:
-					obj->CachedPSO.pCachedBlob = nullptr;
-					obj->CachedPSO.CachedBlobSizeInBytes = 0;
-					break;
-				}
-			}
+					if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO)
+					{
+						Payload.pCachedBlob = nullptr;
+						Payload.CachedBlobSizeInBytes = 0;
+					}
+				});
 		}
 
 		return modified;
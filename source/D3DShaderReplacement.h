@@ -1,15 +1,23 @@
 #pragma once
 
+#include "CComPtr.h"
 #include "D3DPipelineStateStream.h"
 
 namespace D3DShaderReplacement
 {
+	void Initialize();
+	void RefreshReplacementSources();
 	const std::filesystem::path& GetShaderBinDirectory();
 
+	// RootSignatureData is updated to point at the replacement blob when the root signature is overridden. The
+	// blob stays alive for as long as StreamCopy does.
 	bool PatchPipelineStateStream(
 		D3DPipelineStateStream::Copy& StreamCopy,
 		ID3D12Device2 *Device,
-		const std::span<const uint8_t> *RootSignatureData,
+		std::span<const uint8_t> *RootSignatureData,
 		const char *TechniqueName,
 		uint64_t TechniqueId);
+
+	// Identical blobs share one root signature object for the lifetime of the process
+	HRESULT GetOrCreateRootSignature(ID3D12Device2 *Device, std::span<const uint8_t> Data, CComPtr<ID3D12RootSignature>& Signature);
 }
@@ -0,0 +1,31 @@
+#include <xxhash.h>
+#include "Hashing.h"
+
+namespace Hashing
+{
+	uint32_t FNV1A32(const void *Input, size_t Length)
+	{
+		constexpr uint32_t FNV1_PRIME_32 = 0x01000193;
+		constexpr uint32_t FNV1_BASE_32 = 2166136261U;
+
+		auto data = reinterpret_cast<const unsigned char *>(Input);
+		auto end = data + Length;
+
+		auto hash = FNV1_BASE_32;
+
+		for (; data != end; data++)
+		{
+			hash ^= *data;
+			hash *= FNV1_PRIME_32;
+		}
+
+		return hash;
+	}
+
+	uint64_t ComputeContentHash(std::span<const uint8_t> Data, uint64_t Seed)
+	{
+		// FNV-1a consumes a single byte per multiply. XXH3 works on wide stripes and is an order of magnitude
+		// faster on shader-sized inputs.
+		return XXH3_64bits_withSeed(Data.data(), Data.size(), Seed);
+	}
+}
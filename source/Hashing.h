@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace Hashing
+{
+	uint32_t FNV1A32(const void *Input, size_t Length);
+
+	// Hash used to key content-addressed data such as replacement blobs. Equal hashes must still be confirmed
+	// with a full comparison before data is treated as identical. Different seeds give independent hashes.
+	uint64_t ComputeContentHash(std::span<const uint8_t> Data, uint64_t Seed = 0);
+}
@@ -0,0 +1,72 @@
+#include "InFlightPipelines.h"
+
+namespace InFlightPipelines
+{
+	struct KeyHash
+	{
+		size_t operator()(const std::pair<uint64_t, D3DPipelineStateStream::Fingerprint>& Key) const
+		{
+			// Fingerprints are already well distributed
+			return static_cast<size_t>(Key.first ^ Key.second.Low);
+		}
+	};
+
+	std::mutex InFlightLock;
+	std::unordered_map<std::pair<uint64_t, D3DPipelineStateStream::Fingerprint>, std::shared_future<Result>, KeyHash> InFlight;
+
+	Ticket::Ticket(uint64_t TechniqueId, const D3DPipelineStateStream::Fingerprint& Fingerprint, std::promise<Result>&& Promise) :
+		m_Key(TechniqueId, Fingerprint),
+		m_Promise(std::move(Promise))
+	{
+	}
+
+	Ticket::Ticket(Ticket&& Other) :
+		m_Key(Other.m_Key),
+		m_Promise(std::move(Other.m_Promise)),
+		m_Published(std::exchange(Other.m_Published, true))
+	{
+	}
+
+	Ticket::~Ticket()
+	{
+		// Waiters fall back to creating the pipeline themselves
+		Publish(E_ABORT, nullptr);
+	}
+
+	void Ticket::Publish(HRESULT Hr, ID3D12PipelineState *PipelineState)
+	{
+		if (std::exchange(m_Published, true))
+			return;
+
+		{
+			std::scoped_lock lock(InFlightLock);
+			InFlight.erase(m_Key);
+		}
+
+		m_Promise.set_value(Result(Hr, PipelineState));
+	}
+
+	std::variant<Ticket, Result> Join(uint64_t TechniqueId, const D3DPipelineStateStream::Fingerprint& Fingerprint)
+	{
+		std::shared_future<Result> future;
+
+		{
+			std::scoped_lock lock(InFlightLock);
+
+			if (auto itr = InFlight.find({ TechniqueId, Fingerprint }); itr != InFlight.end())
+			{
+				future = itr->second;
+			}
+			else
+			{
+				std::promise<Result> promise;
+				InFlight.emplace(std::make_pair(TechniqueId, Fingerprint), promise.get_future().share());
+
+				return Ticket(TechniqueId, Fingerprint, std::move(promise));
+			}
+		}
+
+		// Waiting happens outside of the lock
+		return future.get();
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "CComPtr.h"
+#include "D3DPipelineStateStream.h"
+
+namespace InFlightPipelines
+{
+	using Result = std::pair<HRESULT, CComPtr<ID3D12PipelineState>>;
+
+	// Held by the first thread to request a pipeline. Every other thread asking for the same pipeline waits
+	// until Publish() is called or the ticket is destroyed, whichever comes first.
+	class Ticket
+	{
+	private:
+		std::pair<uint64_t, D3DPipelineStateStream::Fingerprint> m_Key;
+		std::promise<Result> m_Promise;
+		bool m_Published = false;
+
+	public:
+		Ticket(uint64_t TechniqueId, const D3DPipelineStateStream::Fingerprint& Fingerprint, std::promise<Result>&& Promise);
+		Ticket(const Ticket&) = delete;
+		Ticket(Ticket&& Other);
+		~Ticket();
+
+		void Publish(HRESULT Hr, ID3D12PipelineState *PipelineState);
+	};
+
+	// Either hands the caller a ticket, making it responsible for creating the pipeline, or blocks until the
+	// thread holding the ticket is done and returns its result.
+	std::variant<Ticket, Result> Join(uint64_t TechniqueId, const D3DPipelineStateStream::Fingerprint& Fingerprint);
+}
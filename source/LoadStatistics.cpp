@@ -0,0 +1,282 @@
+#include "CRHooks.h"
+#include "LoadStatistics.h"
+#include "ShaderBlobCache.h"
+
+namespace LoadStatistics
+{
+	constexpr auto IdleReportDelay = std::chrono::seconds(5);
+	constexpr size_t SlowestTechniqueReportCount = 50;
+
+	constexpr std::array<const char *, static_cast<size_t>(Phase::Count)> PhaseNames = {
+		"copy", "lookup", "fprint", "read", "rootsig", "library", "create",
+	};
+
+	constexpr std::array<const char *, static_cast<size_t>(PipelineSource::Count)> SourceNames = {
+		"game library", "patched library", "vanilla compile", "patched compile", "background compile", "coalesced", "warmed", "failed",
+	};
+
+	using PhaseDurations = std::array<std::chrono::steady_clock::duration, static_cast<size_t>(Phase::Count)>;
+
+	struct TechniqueTiming
+	{
+		uint64_t TechniqueId;
+		std::string TechniqueName;
+		PipelineSource Source;
+		PhaseDurations Phases;
+		std::chrono::steady_clock::duration Total;
+	};
+
+	std::atomic_uint64_t PipelinesCreated;
+	std::atomic<std::chrono::steady_clock::rep> LastPipelineCreationTime;
+
+	thread_local ScopedPhaseTimer *TLActivePhaseTimer;
+	thread_local PhaseDurations TLPhaseDurations;
+
+	std::mutex TimingLock;
+	std::vector<TechniqueTiming> Timings;
+
+	std::mutex IdleCallbackLock;
+	std::vector<std::function<void()>> IdleCallbacks;
+
+	ScopedPhaseTimer::ScopedPhaseTimer(Phase Phase) :
+		m_Phase(Phase),
+		m_Parent(TLActivePhaseTimer),
+		m_Start(std::chrono::steady_clock::now())
+	{
+		TLActivePhaseTimer = this;
+	}
+
+	ScopedPhaseTimer::~ScopedPhaseTimer()
+	{
+		const auto elapsed = std::chrono::steady_clock::now() - m_Start;
+
+		TLPhaseDurations[static_cast<size_t>(m_Phase)] += elapsed - m_ChildTime;
+		TLActivePhaseTimer = m_Parent;
+
+		if (m_Parent)
+			m_Parent->m_ChildTime += elapsed;
+	}
+
+	double ToMilliseconds(std::chrono::steady_clock::duration Duration)
+	{
+		return std::chrono::duration<double, std::milli>(Duration).count();
+	}
+
+	void ReportTimings(std::vector<TechniqueTiming>&& Entries)
+	{
+		if (Entries.empty())
+			return;
+
+		std::array<size_t, static_cast<size_t>(PipelineSource::Count)> sourceCounts = {};
+
+		for (const auto& entry : Entries)
+			sourceCounts[static_cast<size_t>(entry.Source)]++;
+
+		std::string sourceSummary;
+
+		for (size_t i = 0; i < sourceCounts.size(); i++)
+		{
+			if (sourceCounts[i] != 0)
+				sourceSummary += fmt::format("{}{} {}", sourceSummary.empty() ? "" : ", ", sourceCounts[i], SourceNames[i]);
+		}
+
+		spdlog::info("Load statistics: Pipeline sources: {}.", sourceSummary);
+
+		// Percentiles per phase and for the whole call
+		const auto percentile = [](std::vector<std::chrono::steady_clock::duration>& Values, double Fraction)
+		{
+			const auto index = std::min(static_cast<size_t>(Fraction * Values.size()), Values.size() - 1);
+			std::nth_element(Values.begin(), Values.begin() + index, Values.end());
+
+			return ToMilliseconds(Values[index]);
+		};
+
+		const auto reportPercentiles = [&](const char *Name, auto&& Selector)
+		{
+			std::vector<std::chrono::steady_clock::duration> values;
+			std::chrono::steady_clock::duration sum = {};
+			values.reserve(Entries.size());
+
+			for (const auto& entry : Entries)
+			{
+				values.emplace_back(Selector(entry));
+				sum += values.back();
+			}
+
+			spdlog::info(
+				"Load statistics: {:>8} sum {:>9.1f} ms | p50 {:>7.3f} p90 {:>7.3f} p99 {:>7.3f} max {:>8.3f} ms",
+				Name,
+				ToMilliseconds(sum),
+				percentile(values, 0.5),
+				percentile(values, 0.9),
+				percentile(values, 0.99),
+				percentile(values, 1.0));
+		};
+
+		reportPercentiles("total", [](const auto& Entry) { return Entry.Total; });
+
+		for (size_t i = 0; i < PhaseNames.size(); i++)
+			reportPercentiles(PhaseNames[i], [&](const auto& Entry) { return Entry.Phases[i]; });
+
+		// Power of two histogram starting at 0.125 ms
+		std::array<size_t, 16> histogram = {};
+
+		for (const auto& entry : Entries)
+		{
+			const auto ms = ToMilliseconds(entry.Total);
+			size_t bucket = 0;
+
+			while (bucket < histogram.size() - 1 && ms >= (0.125 * (1ull << bucket)))
+				bucket++;
+
+			histogram[bucket]++;
+		}
+
+		for (size_t i = 0; i < histogram.size(); i++)
+		{
+			if (histogram[i] == 0)
+				continue;
+
+			if (i == histogram.size() - 1)
+				spdlog::info("Load statistics: {:>9.3f} ms+      {}", 0.125 * (1ull << (i - 1)), histogram[i]);
+			else
+				spdlog::info("Load statistics: < {:>9.3f} ms    {}", 0.125 * (1ull << i), histogram[i]);
+		}
+
+		// Slowest techniques first
+		const auto reportCount = std::min(Entries.size(), SlowestTechniqueReportCount);
+
+		std::partial_sort(
+			Entries.begin(),
+			Entries.begin() + reportCount,
+			Entries.end(),
+			[](const auto& A, const auto& B)
+			{
+				return A.Total > B.Total;
+			});
+
+		spdlog::info("Load statistics: {} slowest technique(s):", reportCount);
+
+		for (size_t i = 0; i < reportCount; i++)
+		{
+			const auto& entry = Entries[i];
+			std::string phases;
+
+			for (size_t j = 0; j < PhaseNames.size(); j++)
+			{
+				if (entry.Phases[j] != std::chrono::steady_clock::duration::zero())
+					phases += fmt::format(" {} {:.3f}", PhaseNames[j], ToMilliseconds(entry.Phases[j]));
+			}
+
+			spdlog::info(
+				"Load statistics: {:>9.3f} ms {:X} {} ({}):{}",
+				ToMilliseconds(entry.Total),
+				entry.TechniqueId,
+				entry.TechniqueName,
+				SourceNames[static_cast<size_t>(entry.Source)],
+				phases);
+		}
+	}
+
+	void ReportStatistics(uint64_t PipelineCount)
+	{
+		spdlog::info("Load statistics: {} pipeline(s) created since the last report.", PipelineCount);
+
+		{
+			std::vector<TechniqueTiming> timings;
+			{
+				std::scoped_lock lock(TimingLock);
+				timings.swap(Timings);
+			}
+
+			ReportTimings(std::move(timings));
+		}
+
+		if (const auto blobs = ShaderBlobCache::GetStatistics(); blobs.TotalBlobCount > 0)
+		{
+			spdlog::info(
+				"Load statistics: {} unique replacement blob(s) out of {} file(s) loaded. {} KB resident, {} KB deduplicated.",
+				blobs.UniqueBlobCount,
+				blobs.TotalBlobCount,
+				blobs.UniqueBytes / 1024,
+				(blobs.TotalBytes - blobs.UniqueBytes) / 1024);
+
+			spdlog::info(
+				"Load statistics: {} replacement file(s) were prefetched before first use, {} loaded synchronously.",
+				blobs.CacheHitCount,
+				blobs.CacheMissCount);
+		}
+
+		if (const auto tracked = CRHooks::GetTrackedMemoryStatistics(); tracked.PipelineCount > 0)
+		{
+			const auto shaders = ShaderBlobCache::GetInternStatistics();
+
+			spdlog::info(
+				"Live update: {} tracked pipeline(s) retain {} KB. Full copies would retain {} KB. {} shader reference(s) share {} "
+				"unique blob(s).",
+				tracked.PipelineCount,
+				(tracked.StreamBytes + shaders.UniqueBytes) / 1024,
+				(tracked.StreamBytes + shaders.ReferencedBytes) / 1024,
+				shaders.ReferenceCount,
+				shaders.UniqueBlobCount);
+		}
+	}
+
+	void IdleMonitorThread()
+	{
+		uint64_t lastReportedCount = 0;
+
+		while (true)
+		{
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+
+			const auto count = PipelinesCreated.load();
+			const auto lastCreation = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(LastPipelineCreationTime.load()));
+
+			if (count == lastReportedCount || std::chrono::steady_clock::now() - lastCreation < IdleReportDelay)
+				continue;
+
+			ReportStatistics(count - lastReportedCount);
+			lastReportedCount = count;
+
+			std::scoped_lock lock(IdleCallbackLock);
+
+			for (const auto& callback : IdleCallbacks)
+				callback();
+		}
+	}
+
+	void NotifyPipelineCreated(uint64_t TechniqueId, const char *TechniqueName, PipelineSource Source)
+	{
+		TechniqueTiming timing {
+			.TechniqueId = TechniqueId,
+			.TechniqueName = TechniqueName ? TechniqueName : "",
+			.Source = Source,
+			.Phases = std::exchange(TLPhaseDurations, {}),
+			.Total = {},
+		};
+
+		for (const auto& duration : timing.Phases)
+			timing.Total += duration;
+
+		{
+			std::scoped_lock lock(TimingLock);
+			Timings.emplace_back(std::move(timing));
+		}
+
+		LastPipelineCreationTime = std::chrono::steady_clock::now().time_since_epoch().count();
+		PipelinesCreated++;
+
+		static bool once = []
+		{
+			std::thread(IdleMonitorThread).detach();
+			return true;
+		}();
+	}
+
+	void AddIdleCallback(std::function<void()> Callback)
+	{
+		std::scoped_lock lock(IdleCallbackLock);
+		IdleCallbacks.emplace_back(std::move(Callback));
+	}
+}
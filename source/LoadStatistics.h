@@ -0,0 +1,54 @@
+#pragma once
+
+namespace LoadStatistics
+{
+	enum class Phase : uint32_t
+	{
+		StreamCopy,
+		PatchLookup,
+		Fingerprint,
+		FileRead,
+		RootSignatureCreation,
+		LibraryLoad,
+		PipelineCreation,
+		Count,
+	};
+
+	enum class PipelineSource : uint32_t
+	{
+		GameLibrary,
+		PatchedLibrary,
+		VanillaCompile,
+		PatchedCompile,
+		BackgroundCompile, // Vanilla pipeline returned while the patched one compiles on a worker
+		Coalesced,		   // Shared with another thread that was creating the same pipeline
+		Warmed,			   // Created ahead of time from the previous session's usage log
+		Failed,
+		Count,
+	};
+
+	// Adds the time spent in scope to a per-thread total for the pipeline currently being created. Timers nest and
+	// only count exclusive time, so a file read inside a patch lookup isn't counted twice.
+	class ScopedPhaseTimer
+	{
+	private:
+		const Phase m_Phase;
+		ScopedPhaseTimer *const m_Parent;
+		const std::chrono::steady_clock::time_point m_Start;
+		std::chrono::steady_clock::duration m_ChildTime = {};
+
+	public:
+		ScopedPhaseTimer(Phase Phase);
+		ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+		~ScopedPhaseTimer();
+	};
+
+	// Starfield doesn't signal when shader loading is done. Treat a few seconds without any new pipelines as
+	// the end of a loading burst and report statistics then. Phase timings gathered on this thread since the
+	// previous call are attributed to TechniqueId.
+	void NotifyPipelineCreated(uint64_t TechniqueId, const char *TechniqueName, PipelineSource Source);
+
+	// Callback runs on the idle monitor thread at the end of every loading burst, after statistics are reported.
+	// Nothing is running on the game's pipeline creation threads at that point.
+	void AddIdleCallback(std::function<void()> Callback);
+}
@@ -0,0 +1,237 @@
+#include <shared_mutex>
+#include "CComPtr.h"
+#include "D3DShaderReplacement.h"
+#include "PatchedPipelineLibrary.h"
+
+namespace PatchedPipelineLibrary
+{
+	//
+	// [LibraryFileHeader]
+	// [ID3D12PipelineLibrary blob]	Opaque driver data from ID3D12PipelineLibrary::Serialize()
+	//
+	constexpr uint32_t LibraryFileMagic = 0x4C505350; // "PSPL"
+	constexpr uint32_t LibraryFileVersion = 1;
+
+	struct LibraryFileHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t LibrarySize;
+	};
+	static_assert(sizeof(LibraryFileHeader) == 0x10);
+
+	// Load and Store may run concurrently on any number of threads
+	std::shared_mutex LibraryLock;
+	CComPtr<ID3D12Device2> LibraryDevice;
+	CComPtr<ID3D12PipelineLibrary1> Library;
+	std::vector<uint8_t> LibraryData; // Must outlive Library
+
+	// Every entry loaded or stored this session. Saving rebuilds the library from these alone.
+	std::mutex SessionLock;
+	std::unordered_map<std::wstring, CComPtr<ID3D12PipelineState>> SessionPipelines;
+	uint32_t PendingStoreCount = 0;
+
+	const std::filesystem::path& GetLibraryPath()
+	{
+		const static auto path = D3DShaderReplacement::GetShaderBinDirectory().parent_path() / "ShaderInjectorPipelines.bin";
+		return path;
+	}
+
+	std::vector<uint8_t> ReadLibraryFile(const std::filesystem::path& Path)
+	{
+		std::ifstream f(Path, std::ios::binary);
+
+		if (!f.good())
+			return {};
+
+		LibraryFileHeader header = {};
+		f.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+		if (!f.good() || header.Magic != LibraryFileMagic || header.Version != LibraryFileVersion || header.LibrarySize == 0)
+			return {};
+
+		std::vector<uint8_t> data(header.LibrarySize);
+		f.read(reinterpret_cast<char *>(data.data()), data.size());
+
+		if (!f.good())
+			return {};
+
+		return data;
+	}
+
+	void Initialize(ID3D12Device2 *Device)
+	{
+		std::unique_lock lock(LibraryLock);
+
+		if (Library)
+			return;
+
+		LibraryDevice = Device;
+		LibraryData = ReadLibraryFile(GetLibraryPath());
+		auto hr = Device->CreatePipelineLibrary(LibraryData.data(), LibraryData.size(), IID_PPV_ARGS(&Library));
+
+		if (FAILED(hr) && !LibraryData.empty())
+		{
+			// Stale or corrupt data. D3D12_ERROR_DRIVER_VERSION_MISMATCH and D3D12_ERROR_ADAPTER_NOT_FOUND are expected
+			// after driver updates and GPU swaps.
+			spdlog::info("Discarding patched pipeline library: {:X}. Pipelines will be recompiled.", static_cast<uint32_t>(hr));
+
+			LibraryData.clear();
+			hr = Device->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&Library));
+		}
+
+		if (FAILED(hr))
+			spdlog::error("Failed to create patched pipeline library: {:X}.", static_cast<uint32_t>(hr));
+		else
+			spdlog::info("Loaded patched pipeline library ({} KB) from {}.", LibraryData.size() / 1024, GetLibraryPath().string());
+	}
+
+	void GetEntryName(uint64_t TechniqueId, const D3DPipelineStateStream::Fingerprint& Fingerprint, wchar_t (&Name)[64])
+	{
+		swprintf(Name, std::size(Name), L"%016llX_%016llX%016llX", TechniqueId, Fingerprint.High, Fingerprint.Low);
+	}
+
+	HRESULT Load(
+		uint64_t TechniqueId,
+		const D3DPipelineStateStream::Fingerprint& Fingerprint,
+		const D3D12_PIPELINE_STATE_STREAM_DESC *Desc,
+		REFIID Riid,
+		void **PipelineState)
+	{
+		wchar_t name[64];
+		GetEntryName(TechniqueId, Fingerprint, name);
+
+		HRESULT hr;
+		{
+			std::shared_lock lock(LibraryLock);
+
+			if (!Library)
+				return E_INVALIDARG;
+
+			hr = Library->LoadPipeline(name, Desc, Riid, PipelineState);
+		}
+
+		// Riid is always ID3D12PipelineState. The hooks reject everything else before getting here.
+		if (SUCCEEDED(hr))
+		{
+			std::scoped_lock lock(SessionLock);
+			SessionPipelines.try_emplace(name, static_cast<ID3D12PipelineState *>(*PipelineState));
+		}
+
+		return hr;
+	}
+
+	void Store(uint64_t TechniqueId, const D3DPipelineStateStream::Fingerprint& Fingerprint, ID3D12PipelineState *PipelineState)
+	{
+		wchar_t name[64];
+		GetEntryName(TechniqueId, Fingerprint, name);
+
+		{
+			std::shared_lock lock(LibraryLock);
+
+			if (!Library)
+				return;
+
+			// E_INVALIDARG means another thread stored the same pipeline first
+			if (FAILED(Library->StorePipeline(name, PipelineState)))
+				return;
+		}
+
+		std::scoped_lock lock(SessionLock);
+		SessionPipelines.try_emplace(name, PipelineState);
+		PendingStoreCount++;
+	}
+
+	void Save()
+	{
+		std::vector<std::pair<std::wstring, CComPtr<ID3D12PipelineState>>> entries;
+		uint32_t storeCount = 0;
+
+		{
+			std::scoped_lock lock(SessionLock);
+
+			if (PendingStoreCount == 0)
+				return;
+
+			storeCount = PendingStoreCount;
+			entries.assign(SessionPipelines.begin(), SessionPipelines.end());
+		}
+
+		CComPtr<ID3D12Device2> device;
+		{
+			std::shared_lock lock(LibraryLock);
+			device = LibraryDevice;
+		}
+
+		if (!device)
+			return;
+
+		// ID3D12PipelineLibrary can't remove entries and every shader edit adds a new name. Serializing the loaded
+		// library would keep everything ever stored. Build a fresh one from the pipelines used this session instead,
+		// which also keeps the game's threads from waiting on the serialization. Pipeline warmup loads everything
+		// in its usage log at startup, so those entries survive sessions that don't use them.
+		CComPtr<ID3D12PipelineLibrary1> library;
+		std::vector<uint8_t> data;
+
+		if (const auto hr = device->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&library)); FAILED(hr))
+		{
+			spdlog::error("Failed to create patched pipeline library for saving: {:X}.", static_cast<uint32_t>(hr));
+			return;
+		}
+
+		for (const auto& [name, pipelineState] : entries)
+			library->StorePipeline(name.c_str(), pipelineState.Get());
+
+		data.resize(library->GetSerializedSize());
+
+		if (const auto hr = library->Serialize(data.data(), data.size()); FAILED(hr))
+		{
+			spdlog::error("Failed to serialize patched pipeline library: {:X}.", static_cast<uint32_t>(hr));
+			return;
+		}
+
+		// Write to a temporary file first. A crash halfway through must not destroy the previous library.
+		auto tempPath = GetLibraryPath();
+		tempPath += ".tmp";
+
+		{
+			std::ofstream f(tempPath, std::ios::binary | std::ios::trunc);
+
+			const LibraryFileHeader header {
+				.Magic = LibraryFileMagic,
+				.Version = LibraryFileVersion,
+				.LibrarySize = data.size(),
+			};
+
+			f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+			f.write(reinterpret_cast<const char *>(data.data()), data.size());
+
+			if (!f.good())
+			{
+				spdlog::error("Failed to write patched pipeline library {}.", tempPath.string());
+				return;
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(tempPath, GetLibraryPath(), ec);
+
+		if (ec)
+		{
+			spdlog::error("Failed to save patched pipeline library {}: {}", GetLibraryPath().string(), ec.message());
+			return;
+		}
+
+		// Stores made since the snapshot are still pending
+		{
+			std::scoped_lock lock(SessionLock);
+			PendingStoreCount -= storeCount;
+		}
+
+		spdlog::info(
+			"Saved {} patched pipeline(s), {} of them new. Library size: {} KB.",
+			entries.size(),
+			storeCount,
+			data.size() / 1024);
+	}
+}
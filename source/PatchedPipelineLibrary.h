@@ -0,0 +1,27 @@
+#pragma once
+
+#include "D3DPipelineStateStream.h"
+
+namespace PatchedPipelineLibrary
+{
+	// Patched pipelines never go into the game's pipeline library. They're kept in a separate one, saved next to
+	// the custom shader directory, so the driver doesn't have to compile them again on every launch.
+	//
+	// Entries are named after the technique id and the fingerprint of the patched stream, which covers the content
+	// of every replacement. Editing a file produces a new name. Driver or adapter changes are rejected by D3D12
+	// itself and the library starts over empty.
+	void Initialize(ID3D12Device2 *Device);
+
+	HRESULT Load(
+		uint64_t TechniqueId,
+		const D3DPipelineStateStream::Fingerprint& Fingerprint,
+		const D3D12_PIPELINE_STATE_STREAM_DESC *Desc,
+		REFIID Riid,
+		void **PipelineState);
+
+	void Store(uint64_t TechniqueId, const D3DPipelineStateStream::Fingerprint& Fingerprint, ID3D12PipelineState *PipelineState);
+
+	// Writes the library to disk if anything new was stored since the last save. Only pipelines loaded or stored
+	// during this session are written, so entries for edited or unused replacements don't pile up.
+	void Save();
+}
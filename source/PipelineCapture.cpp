@@ -0,0 +1,222 @@
+#include "CComPtr.h"
+#include "D3DPipelineStateStream.h"
+#include "D3DShaderReplacement.h"
+#include "PipelineCapture.h"
+#include "Plugin.h"
+
+namespace PipelineCapture
+{
+	//
+	// [CaptureFileHeader]
+	// [CaptureRecordHeader][TechniqueName][RootSignatureData][SerializedStream]	Repeated until the end of the file
+	//
+	constexpr uint32_t CaptureFileMagic = 0x50435350; // "PSCP"
+	constexpr uint32_t CaptureFileVersion = 1;
+	constexpr size_t CaptureBufferSize = 1024 * 1024;
+
+	struct CaptureFileHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+	};
+	static_assert(sizeof(CaptureFileHeader) == 0x8);
+
+	struct CaptureRecordHeader
+	{
+		uint64_t TechniqueId;
+		uint64_t DurationNanoseconds;
+		uint32_t NameLength;
+		uint32_t RootSignatureSize;
+		uint64_t StreamSize;
+	};
+	static_assert(sizeof(CaptureRecordHeader) == 0x20);
+
+	std::mutex CaptureLock;
+	std::ofstream CaptureFile;
+	size_t CapturedCount;
+
+	bool IsEnabled()
+	{
+		return !Plugin::PipelineCapturePath.empty();
+	}
+
+	void Record(
+		uint64_t TechniqueId,
+		const char *TechniqueName,
+		std::span<const uint8_t> SerializedStream,
+		std::span<const uint8_t> RootSignatureData,
+		std::chrono::steady_clock::duration Duration)
+	{
+		if (SerializedStream.empty())
+			return;
+
+		const std::string_view name(TechniqueName ? TechniqueName : "");
+
+		const CaptureRecordHeader header {
+			.TechniqueId = TechniqueId,
+			.DurationNanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Duration).count()),
+			.NameLength = static_cast<uint32_t>(name.size()),
+			.RootSignatureSize = static_cast<uint32_t>(RootSignatureData.size()),
+			.StreamSize = SerializedStream.size(),
+		};
+
+		std::scoped_lock lock(CaptureLock);
+
+		if (!CaptureFile.is_open())
+		{
+			static char captureBuffer[CaptureBufferSize];
+			CaptureFile.rdbuf()->pubsetbuf(captureBuffer, sizeof(captureBuffer));
+			CaptureFile.open(Plugin::PipelineCapturePath, std::ios::binary | std::ios::trunc);
+
+			if (!CaptureFile.good())
+			{
+				spdlog::error("Failed to open pipeline capture file {}.", Plugin::PipelineCapturePath.string());
+				return;
+			}
+
+			const CaptureFileHeader fileHeader {
+				.Magic = CaptureFileMagic,
+				.Version = CaptureFileVersion,
+			};
+
+			CaptureFile.write(reinterpret_cast<const char *>(&fileHeader), sizeof(fileHeader));
+		}
+
+		CaptureFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		CaptureFile.write(name.data(), name.size());
+		CaptureFile.write(reinterpret_cast<const char *>(RootSignatureData.data()), RootSignatureData.size());
+		CaptureFile.write(reinterpret_cast<const char *>(SerializedStream.data()), SerializedStream.size());
+		CapturedCount++;
+	}
+
+	void Flush()
+	{
+		std::scoped_lock lock(CaptureLock);
+
+		if (!CaptureFile.is_open())
+			return;
+
+		CaptureFile.flush();
+		spdlog::info("Pipeline capture: {} request(s) written to {}.", CapturedCount, Plugin::PipelineCapturePath.string());
+	}
+
+	bool Replay(const std::filesystem::path& Path, ID3D12Device2 *Device)
+	{
+		std::ifstream f(Path, std::ios::binary | std::ios::ate);
+		CaptureFileHeader fileHeader = {};
+
+		const auto fileSize = f.good() ? static_cast<uint64_t>(f.tellg()) : 0;
+		f.seekg(0);
+
+		if (!f.read(reinterpret_cast<char *>(&fileHeader), sizeof(fileHeader)) || fileHeader.Magic != CaptureFileMagic ||
+			fileHeader.Version != CaptureFileVersion)
+		{
+			spdlog::error("Pipeline replay: {} isn't a valid capture file.", Path.string());
+			return false;
+		}
+
+		size_t requestCount = 0;
+		size_t patchedCount = 0;
+		size_t failedCount = 0;
+		std::chrono::steady_clock::duration capturedTime = {};
+		std::chrono::steady_clock::duration patchTime = {};
+		std::chrono::steady_clock::duration createTime = {};
+
+		std::string name;
+		std::vector<uint8_t> rootSignatureData;
+		std::vector<uint8_t> streamData;
+
+		for (CaptureRecordHeader header; f.read(reinterpret_cast<char *>(&header), sizeof(header));)
+		{
+			// Sizes are checked against what's left before anything is allocated
+			const auto remaining = fileSize - static_cast<uint64_t>(f.tellg());
+			const auto prefixSize = static_cast<uint64_t>(header.NameLength) + header.RootSignatureSize;
+
+			if (header.StreamSize > remaining || remaining - header.StreamSize < prefixSize)
+			{
+				spdlog::error("Pipeline replay: Capture is truncated after {} request(s).", requestCount);
+				return false;
+			}
+
+			name.resize(header.NameLength);
+			rootSignatureData.resize(header.RootSignatureSize);
+			streamData.resize(header.StreamSize);
+
+			f.read(name.data(), name.size());
+			f.read(reinterpret_cast<char *>(rootSignatureData.data()), rootSignatureData.size());
+			f.read(reinterpret_cast<char *>(streamData.data()), streamData.size());
+
+			if (!f.good())
+			{
+				spdlog::error("Pipeline replay: Capture is truncated after {} request(s).", requestCount);
+				return false;
+			}
+
+			auto streamCopy = D3DPipelineStateStream::Copy::Deserialize(streamData);
+
+			if (!streamCopy)
+			{
+				spdlog::error("Pipeline replay: Malformed stream. Shader technique: {:X}.", header.TechniqueId);
+				return false;
+			}
+
+			requestCount++;
+			capturedTime += std::chrono::nanoseconds(header.DurationNanoseconds);
+
+			// Root signature objects don't survive serialization
+			if (!rootSignatureData.empty())
+			{
+				CComPtr<ID3D12RootSignature> rootSignature;
+				Device->CreateRootSignature(0, rootSignatureData.data(), rootSignatureData.size(), IID_PPV_ARGS(&rootSignature));
+
+				D3DPipelineStateStream::ForEachSubobject(
+					streamCopy->GetDesc(),
+					[&](auto Type, auto& Payload)
+					{
+						if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE)
+							Payload = rootSignature.Get();
+					});
+
+				streamCopy->TrackObject(std::move(rootSignature));
+			}
+
+			// Mirrors CreatePipelineStateForTechnique minus the pipeline libraries
+			std::span<const uint8_t> rootSignatureSpan(rootSignatureData);
+
+			const auto patchStart = std::chrono::steady_clock::now();
+			const bool patched =
+				D3DShaderReplacement::PatchPipelineStateStream(*streamCopy, Device, &rootSignatureSpan, name.c_str(), header.TechniqueId);
+			const auto patchEnd = std::chrono::steady_clock::now();
+
+			CComPtr<ID3D12PipelineState> pipelineState;
+			const auto hr = Device->CreatePipelineState(streamCopy->GetDesc(), IID_PPV_ARGS(&pipelineState));
+			const auto createEnd = std::chrono::steady_clock::now();
+
+			patchTime += patchEnd - patchStart;
+			createTime += createEnd - patchEnd;
+
+			if (patched)
+				patchedCount++;
+
+			if (FAILED(hr))
+				failedCount++;
+		}
+
+		const auto toMilliseconds = [](std::chrono::steady_clock::duration Duration)
+		{
+			return std::chrono::duration<double, std::milli>(Duration).count();
+		};
+
+		spdlog::info(
+			"Pipeline replay: {} request(s), {} patched, {} failed. Patching took {:.1f} ms and creation {:.1f} ms. Captured "
+			"total: {:.1f} ms.",
+			requestCount,
+			patchedCount,
+			failedCount,
+			toMilliseconds(patchTime),
+			toMilliseconds(createTime),
+			toMilliseconds(capturedTime));
+
+		return true;
+	}
+}
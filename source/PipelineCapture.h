@@ -0,0 +1,24 @@
+#pragma once
+
+namespace PipelineCapture
+{
+	// Records every CreatePipelineStateForTechnique call to PipelineCapturePath: the technique, its vanilla stream
+	// flattened with D3DPipelineStateStream::Copy::Serialize(), the root signature blob and how long the call took.
+	bool IsEnabled();
+
+	void Record(
+		uint64_t TechniqueId,
+		const char *TechniqueName,
+		std::span<const uint8_t> SerializedStream,
+		std::span<const uint8_t> RootSignatureData,
+		std::chrono::steady_clock::duration Duration);
+
+	// Called at idle points such as loading screens. Nothing is written at process exit, so requests recorded
+	// after the last flush stay in the buffer and are lost.
+	void Flush();
+
+	// Feeds a capture back through D3DShaderReplacement::PatchPipelineStateStream and Device, in the original
+	// order, and logs how long it took compared to the capture. Doesn't need the game: tests/PipelineReplay runs it
+	// against StubDevice.
+	bool Replay(const std::filesystem::path& Path, ID3D12Device2 *Device);
+}
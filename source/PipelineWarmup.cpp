@@ -0,0 +1,403 @@
+#include <unordered_set>
+#include "CComPtr.h"
+#include "D3DShaderReplacement.h"
+#include "InFlightPipelines.h"
+#include "PatchedPipelineLibrary.h"
+#include "PipelineWarmup.h"
+#include "Plugin.h"
+
+namespace PipelineWarmup
+{
+	//
+	// [UsageFileHeader]
+	// [UsageRecordHeader][TechniqueName][RootSignatureData][SerializedStream]	Repeated RecordCount times in first use order
+	//
+	constexpr uint32_t UsageFileMagic = 0x55575350; // "PSWU"
+	constexpr uint32_t UsageFileVersion = 1;
+
+	struct UsageFileHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t RecordCount;
+	};
+	static_assert(sizeof(UsageFileHeader) == 0x10);
+
+	struct UsageRecordHeader
+	{
+		uint64_t TechniqueId;
+		D3DPipelineStateStream::Fingerprint Fingerprint; // Patched stream, i.e. the content of every replacement
+		uint32_t NameLength;
+		uint32_t RootSignatureSize;
+		uint64_t StreamSize;
+	};
+	static_assert(sizeof(UsageRecordHeader) == 0x28);
+
+	struct UsageEntry
+	{
+		uint64_t TechniqueId;
+		D3DPipelineStateStream::Fingerprint Fingerprint;
+		std::string TechniqueName;
+		std::vector<uint8_t> RootSignatureData; // Vanilla
+		std::vector<uint8_t> SerializedStream;	// Vanilla
+		bool Stale = false;
+	};
+
+	using EntryKey = std::pair<uint64_t, D3DPipelineStateStream::Fingerprint>;
+
+	struct KeyHash
+	{
+		size_t operator()(const EntryKey& Key) const
+		{
+			// Fingerprints are already well distributed
+			return static_cast<size_t>(Key.first ^ Key.second.Low);
+		}
+	};
+
+	// PreviousEntries is filled once before the warmup thread starts. Only the Stale flags change afterwards.
+	std::mutex UsageLock;
+	std::vector<UsageEntry> PreviousEntries;
+	std::vector<UsageEntry> SessionEntries;
+	std::unordered_set<EntryKey, KeyHash> SessionKeys;
+	bool UsageChanged = false;
+
+	std::mutex WarmedLock;
+	std::unordered_map<EntryKey, CComPtr<ID3D12PipelineState>, KeyHash> WarmedPipelines;
+
+	const std::filesystem::path& GetUsageLogPath()
+	{
+		const static auto path = D3DShaderReplacement::GetShaderBinDirectory().parent_path() / "ShaderInjectorWarmup.bin";
+		return path;
+	}
+
+	std::vector<UsageEntry> ReadUsageLog(const std::filesystem::path& Path)
+	{
+		std::ifstream f(Path, std::ios::binary | std::ios::ate);
+
+		if (!f.good())
+			return {};
+
+		std::vector<uint8_t> fileData(static_cast<size_t>(f.tellg()));
+		f.seekg(0);
+
+		if (!f.read(reinterpret_cast<char *>(fileData.data()), fileData.size()))
+			return {};
+
+		std::span<const uint8_t> data(fileData);
+
+		const auto read = [&](void *Destination, size_t Size)
+		{
+			if (data.size() < Size)
+				return false;
+
+			memcpy(Destination, data.data(), Size);
+			data = data.subspan(Size);
+			return true;
+		};
+
+		UsageFileHeader header = {};
+
+		if (!read(&header, sizeof(header)) || header.Magic != UsageFileMagic || header.Version != UsageFileVersion)
+			return {};
+
+		std::vector<UsageEntry> entries;
+
+		for (uint64_t i = 0; i < header.RecordCount; i++)
+		{
+			UsageRecordHeader record = {};
+
+			if (!read(&record, sizeof(record)))
+				return {};
+
+			auto& entry = entries.emplace_back(UsageEntry {
+				.TechniqueId = record.TechniqueId,
+				.Fingerprint = record.Fingerprint,
+			});
+
+			// Sizes are checked against what's left before anything is allocated
+			if (data.size() < static_cast<uint64_t>(record.NameLength) + record.RootSignatureSize + record.StreamSize)
+				return {};
+
+			entry.TechniqueName.resize(record.NameLength);
+			entry.RootSignatureData.resize(record.RootSignatureSize);
+			entry.SerializedStream.resize(record.StreamSize);
+
+			read(entry.TechniqueName.data(), entry.TechniqueName.size());
+			read(entry.RootSignatureData.data(), entry.RootSignatureData.size());
+			read(entry.SerializedStream.data(), entry.SerializedStream.size());
+		}
+
+		return entries;
+	}
+
+	// Returns false if the entry is stale and shouldn't be logged again
+	bool WarmPipeline(ID3D12Device2 *Device, const UsageEntry& Entry)
+	{
+		const EntryKey key(Entry.TechniqueId, Entry.Fingerprint);
+
+		// The game got there first
+		{
+			std::scoped_lock lock(UsageLock);
+
+			if (SessionKeys.contains(key))
+				return true;
+		}
+
+		auto streamCopy = D3DPipelineStateStream::Copy::Deserialize(Entry.SerializedStream);
+
+		if (!streamCopy)
+			return false;
+
+		// Root signature objects don't survive serialization
+		if (!Entry.RootSignatureData.empty())
+		{
+			CComPtr<ID3D12RootSignature> rootSignature;
+
+			if (FAILED(D3DShaderReplacement::GetOrCreateRootSignature(Device, Entry.RootSignatureData, rootSignature)))
+				return false;
+
+			D3DPipelineStateStream::ForEachSubobject(
+				streamCopy->GetDesc(),
+				[&](auto Type, auto& Payload)
+				{
+					if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE)
+						Payload = rootSignature.Get();
+				});
+
+			streamCopy->TrackObject(std::move(rootSignature));
+		}
+
+		// Replacements are looked up again from scratch. If any of them changed, was added or was removed since the
+		// entry was logged, the fingerprint won't match anymore.
+		std::span<const uint8_t> rootSignatureData(Entry.RootSignatureData);
+
+		if (!D3DShaderReplacement::PatchPipelineStateStream(
+				*streamCopy,
+				Device,
+				&rootSignatureData,
+				Entry.TechniqueName.c_str(),
+				Entry.TechniqueId))
+			return false;
+
+		if (D3DPipelineStateStream::ComputeFingerprint(streamCopy->GetDesc(), rootSignatureData) != Entry.Fingerprint)
+			return false;
+
+		// Hook calls for the same pipeline wait for us instead of compiling it a second time, and vice versa
+		auto joined = InFlightPipelines::Join(Entry.TechniqueId, Entry.Fingerprint);
+		auto ticket = std::get_if<InFlightPipelines::Ticket>(&joined);
+
+		if (!ticket)
+			return SUCCEEDED(std::get<InFlightPipelines::Result>(joined).first);
+
+		CComPtr<ID3D12PipelineState> pipelineState;
+		auto hr = PatchedPipelineLibrary::Load(Entry.TechniqueId, Entry.Fingerprint, streamCopy->GetDesc(), IID_PPV_ARGS(&pipelineState));
+
+		if (FAILED(hr))
+		{
+			hr = Device->CreatePipelineState(streamCopy->GetDesc(), IID_PPV_ARGS(&pipelineState));
+
+			if (SUCCEEDED(hr))
+				PatchedPipelineLibrary::Store(Entry.TechniqueId, Entry.Fingerprint, pipelineState.Get());
+		}
+
+		if (FAILED(hr))
+		{
+			ticket->Publish(hr, nullptr);
+
+			spdlog::warn(
+				"Pipeline warmup: CreatePipelineState failed and returned {:X}. Shader technique: {:X}.",
+				static_cast<uint32_t>(hr),
+				Entry.TechniqueId);
+
+			return false;
+		}
+
+		// Must be visible to TakePipeline before waiters are released. A hook call that joined the ticket records
+		// the pipeline as used right after, and Record() only drops warmed entries that already exist. If the game
+		// created and recorded this pipeline on its own in the meantime, nothing would ever take the warmed copy.
+		{
+			std::scoped_lock lock(UsageLock, WarmedLock);
+
+			if (!SessionKeys.contains(key))
+				WarmedPipelines.emplace(key, pipelineState);
+		}
+
+		ticket->Publish(hr, pipelineState.Get());
+		return true;
+	}
+
+	void WarmupThread(CComPtr<ID3D12Device2> Device)
+	{
+		const auto startTime = std::chrono::steady_clock::now();
+		size_t staleCount = 0;
+
+		for (auto& entry : PreviousEntries)
+		{
+			if (WarmPipeline(Device.Get(), entry))
+				continue;
+
+			std::scoped_lock lock(UsageLock);
+			entry.Stale = true;
+			UsageChanged = true;
+			staleCount++;
+		}
+
+		spdlog::info(
+			"Pipeline warmup: Processed {} logged pipeline(s) in {:.1f} ms. {} stale entries dropped.",
+			PreviousEntries.size(),
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count(),
+			staleCount);
+	}
+
+	void Initialize(ID3D12Device2 *Device)
+	{
+		if (!Plugin::WarmupPatchedPipelines)
+			return;
+
+		{
+			std::scoped_lock lock(UsageLock);
+			PreviousEntries = ReadUsageLog(GetUsageLogPath());
+
+			if (PreviousEntries.empty())
+				return;
+		}
+
+		spdlog::info("Pipeline warmup: Loaded {} entries from {}.", PreviousEntries.size(), GetUsageLogPath().string());
+		std::thread(WarmupThread, CComPtr<ID3D12Device2>(Device)).detach();
+	}
+
+	void Record(
+		uint64_t TechniqueId,
+		const char *TechniqueName,
+		const D3DPipelineStateStream::Fingerprint& Fingerprint,
+		const D3D12_PIPELINE_STATE_STREAM_DESC *VanillaDesc,
+		std::span<const uint8_t> RootSignatureData)
+	{
+		if (!Plugin::WarmupPatchedPipelines)
+			return;
+
+		const EntryKey key(TechniqueId, Fingerprint);
+
+		{
+			std::scoped_lock lock(UsageLock);
+
+			if (!SessionKeys.emplace(key).second)
+				return;
+		}
+
+		// The game owns the pipeline now. A warmed copy that was shared through InFlightPipelines isn't needed anymore.
+		{
+			std::scoped_lock lock(WarmedLock);
+			WarmedPipelines.erase(key);
+		}
+
+		UsageEntry entry {
+			.TechniqueId = TechniqueId,
+			.Fingerprint = Fingerprint,
+			.TechniqueName = TechniqueName ? TechniqueName : "",
+			.RootSignatureData = { RootSignatureData.begin(), RootSignatureData.end() },
+			.SerializedStream = D3DPipelineStateStream::Copy(VanillaDesc).Serialize(),
+		};
+
+		if (entry.SerializedStream.empty())
+			return;
+
+		std::scoped_lock lock(UsageLock);
+		SessionEntries.emplace_back(std::move(entry));
+		UsageChanged = true;
+	}
+
+	bool TakePipeline(uint64_t TechniqueId, const D3DPipelineStateStream::Fingerprint& Fingerprint, void **PipelineState)
+	{
+		std::scoped_lock lock(WarmedLock);
+		auto node = WarmedPipelines.extract({ TechniqueId, Fingerprint });
+
+		if (node.empty())
+			return false;
+
+		*PipelineState = node.mapped().Detach();
+		return true;
+	}
+
+	void Save()
+	{
+		std::vector<uint8_t> data;
+		uint64_t recordCount = 0;
+
+		{
+			std::scoped_lock lock(UsageLock);
+
+			if (!UsageChanged)
+				return;
+
+			UsageChanged = false;
+			data.resize(sizeof(UsageFileHeader));
+
+			const auto append = [&](const void *Source, size_t Size)
+			{
+				const auto offset = data.size();
+				data.resize(offset + Size);
+				memcpy(data.data() + offset, Source, Size);
+			};
+
+			const auto appendEntry = [&](const UsageEntry& Entry)
+			{
+				const UsageRecordHeader record {
+					.TechniqueId = Entry.TechniqueId,
+					.Fingerprint = Entry.Fingerprint,
+					.NameLength = static_cast<uint32_t>(Entry.TechniqueName.size()),
+					.RootSignatureSize = static_cast<uint32_t>(Entry.RootSignatureData.size()),
+					.StreamSize = Entry.SerializedStream.size(),
+				};
+
+				append(&record, sizeof(record));
+				append(Entry.TechniqueName.data(), Entry.TechniqueName.size());
+				append(Entry.RootSignatureData.data(), Entry.RootSignatureData.size());
+				append(Entry.SerializedStream.data(), Entry.SerializedStream.size());
+				recordCount++;
+			};
+
+			for (const auto& entry : SessionEntries)
+				appendEntry(entry);
+
+			// Logged pipelines that weren't needed this session keep their relative order after the ones that were.
+			// The game may still ask for them later, e.g. in areas that haven't been visited yet.
+			for (const auto& entry : PreviousEntries)
+			{
+				if (!entry.Stale && !SessionKeys.contains({ entry.TechniqueId, entry.Fingerprint }))
+					appendEntry(entry);
+			}
+		}
+
+		const UsageFileHeader header {
+			.Magic = UsageFileMagic,
+			.Version = UsageFileVersion,
+			.RecordCount = recordCount,
+		};
+
+		memcpy(data.data(), &header, sizeof(header));
+
+		// Write to a temporary file first. A crash halfway through must not destroy the previous log.
+		auto tempPath = GetUsageLogPath();
+		tempPath += ".tmp";
+
+		{
+			std::ofstream f(tempPath, std::ios::binary | std::ios::trunc);
+			f.write(reinterpret_cast<const char *>(data.data()), data.size());
+
+			if (!f.good())
+			{
+				spdlog::error("Failed to write pipeline warmup log {}.", tempPath.string());
+				return;
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(tempPath, GetUsageLogPath(), ec);
+
+		if (ec)
+			spdlog::error("Failed to save pipeline warmup log {}: {}", GetUsageLogPath().string(), ec.message());
+		else
+			spdlog::info("Saved pipeline warmup log with {} entries ({} KB).", recordCount, data.size() / 1024);
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "D3DPipelineStateStream.h"
+
+namespace PipelineWarmup
+{
+	// Patched pipelines are logged in the order they're first used, along with the vanilla stream they were built
+	// from. On the next launch a background thread patches and creates them in the same order so the game finds
+	// them ready. Entries whose replacements changed no longer match the logged fingerprint and are dropped.
+	void Initialize(ID3D12Device2 *Device);
+
+	void Record(
+		uint64_t TechniqueId,
+		const char *TechniqueName,
+		const D3DPipelineStateStream::Fingerprint& Fingerprint,
+		const D3D12_PIPELINE_STATE_STREAM_DESC *VanillaDesc,
+		std::span<const uint8_t> RootSignatureData);
+
+	// Hands over a pre-created pipeline. Each one can only be taken once.
+	bool TakePipeline(uint64_t TechniqueId, const D3DPipelineStateStream::Fingerprint& Fingerprint, void **PipelineState);
+
+	// Writes the usage log to disk if anything new was recorded since the last save
+	void Save();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+//
+// OS services used by otherwise portable modules. The plugin uses PlatformWin32.cpp. Tests built outside of Windows
+// link tests/PlatformPosix.cpp instead.
+//
+namespace Platform
+{
+	// Reads a whole file into memory. Mapped views are shared with the page cache, but they also keep other processes
+	// from overwriting the file. Owner keeps the returned memory alive. Empty files are reported as failures.
+	std::span<const uint8_t> LoadFile(
+		const std::filesystem::path& Path,
+		bool PrivateCopy,
+		std::shared_ptr<const void>& Owner,
+		std::error_code& Error);
+
+	// Queues reads for pages that are about to be touched. Only a hint.
+	void PrefetchMemory(std::span<const uint8_t> Data);
+
+	// Invokes Callback every time a file below Directory is written, created, renamed or deleted. Never returns unless
+	// watching fails.
+	std::error_code WatchDirectory(const std::filesystem::path& Directory, const std::function<void()>& Callback);
+}
@@ -0,0 +1,108 @@
+#include "Platform.h"
+
+namespace Platform
+{
+	std::error_code GetLastErrorCode()
+	{
+		return std::error_code(static_cast<int>(GetLastError()), std::system_category());
+	}
+
+	std::span<const uint8_t> LoadFile(
+		const std::filesystem::path& Path,
+		bool PrivateCopy,
+		std::shared_ptr<const void>& Owner,
+		std::error_code& Error)
+	{
+		const auto fileHandle = CreateFileW(
+			Path.c_str(),
+			GENERIC_READ,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr,
+			OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+			nullptr);
+
+		if (fileHandle == INVALID_HANDLE_VALUE)
+		{
+			Error = GetLastErrorCode();
+			return {};
+		}
+
+		std::span<const uint8_t> data;
+		LARGE_INTEGER fileSize = {};
+
+		// Zero-length files can't be mapped
+		if (GetFileSizeEx(fileHandle, &fileSize) && fileSize.QuadPart > 0 && fileSize.QuadPart <= std::numeric_limits<DWORD>::max())
+		{
+			const auto size = static_cast<size_t>(fileSize.QuadPart);
+
+			if (PrivateCopy)
+			{
+				std::shared_ptr<uint8_t[]> heapData(new uint8_t[size]);
+				DWORD bytesRead = 0;
+
+				if (ReadFile(fileHandle, heapData.get(), static_cast<DWORD>(size), &bytesRead, nullptr) && bytesRead == size)
+				{
+					data = { heapData.get(), size };
+					Owner = std::move(heapData);
+				}
+			}
+			else
+			{
+				// The view holds its own reference to the section. Both handles can be closed right away.
+				if (const auto mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr))
+				{
+					if (const auto view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0))
+					{
+						data = { static_cast<const uint8_t *>(view), size };
+						Owner = std::shared_ptr<const void>(
+							view,
+							[](const void *View)
+							{
+								UnmapViewOfFile(View);
+							});
+					}
+
+					CloseHandle(mappingHandle);
+				}
+			}
+		}
+
+		Error = GetLastErrorCode();
+		CloseHandle(fileHandle);
+
+		return data;
+	}
+
+	void PrefetchMemory(std::span<const uint8_t> Data)
+	{
+		WIN32_MEMORY_RANGE_ENTRY range {
+			.VirtualAddress = const_cast<uint8_t *>(Data.data()),
+			.NumberOfBytes = Data.size(),
+		};
+
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+
+	std::error_code WatchDirectory(const std::filesystem::path& Directory, const std::function<void()>& Callback)
+	{
+		const auto changeHandle = FindFirstChangeNotificationW(
+			Directory.c_str(),
+			true,
+			FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+
+		if (changeHandle == INVALID_HANDLE_VALUE)
+			return GetLastErrorCode();
+
+		while (WaitForSingleObject(changeHandle, INFINITE) == WAIT_OBJECT_0)
+		{
+			Callback();
+			FindNextChangeNotification(changeHandle);
+		}
+
+		const auto error = GetLastErrorCode();
+		FindCloseChangeNotification(changeHandle);
+
+		return error;
+	}
+}
@@ -1,13 +1,20 @@
 #include <spdlog/sinks/basic_file_sink.h>
 #include <toml++/toml.h>
 #include <ShlObj.h>
+#include "D3DShaderReplacement.h"
 #include "Plugin.h"
 
 namespace Plugin
 {
 	bool AllowLiveUpdates = false;
 	bool InsertDebugMarkers = false;
+	bool AsyncPatchedPipelines = false;
+	bool WarmupPatchedPipelines = false;
 	std::filesystem::path ShaderDumpBinPath;
+	bool DeduplicateShaderDump = false;
+	std::filesystem::path ShaderDumpMaterializePath;
+	std::filesystem::path ShaderArchivePackPath;
+	std::filesystem::path PipelineCapturePath;
 
 	bool Initialize(bool UseASI)
 	{
@@ -22,6 +29,7 @@ namespace Plugin
 		if (!Hooks::Initialize())
 			return false;
 
+		D3DShaderReplacement::Initialize();
 		return true;
 	}
 
@@ -72,7 +80,13 @@ namespace Plugin
 			{
 				AllowLiveUpdates = toml["Development"]["AllowLiveUpdates"].value_or(false);
 				InsertDebugMarkers = toml["Development"]["InsertDebugMarkers"].value_or(false);
+				AsyncPatchedPipelines = toml["Development"]["AsyncPatchedPipelines"].value_or(false);
+				WarmupPatchedPipelines = toml["Development"]["WarmupPatchedPipelines"].value_or(false);
 				ShaderDumpBinPath = toml["Development"]["ShaderDumpBinPath"].value_or(L"");
+				DeduplicateShaderDump = toml["Development"]["DeduplicateShaderDump"].value_or(false);
+				ShaderDumpMaterializePath = toml["Development"]["ShaderDumpMaterializePath"].value_or(L"");
+				ShaderArchivePackPath = toml["Development"]["ShaderArchivePackPath"].value_or(L"");
+				PipelineCapturePath = toml["Development"]["PipelineCapturePath"].value_or(L"");
 			}
 
 			if (!ShaderDumpBinPath.empty())
@@ -4,7 +4,13 @@ namespace Plugin
 {
 	extern bool AllowLiveUpdates;
 	extern bool InsertDebugMarkers;
+	extern bool AsyncPatchedPipelines;
+	extern bool WarmupPatchedPipelines;
 	extern std::filesystem::path ShaderDumpBinPath;
+	extern bool DeduplicateShaderDump;
+	extern std::filesystem::path ShaderDumpMaterializePath;
+	extern std::filesystem::path ShaderArchivePackPath;
+	extern std::filesystem::path PipelineCapturePath;
 
 	bool Initialize(bool UseASI);
 	bool InitializeLog(bool UseASI);
@@ -0,0 +1,77 @@
+#include <bit>
+#include "ReplacementFilter.h"
+
+namespace ReplacementFilter
+{
+	constexpr size_t BitsPerKey = 16;
+	constexpr size_t FalsePositiveSampleCount = 1 << 16;
+
+	std::mutex FilterLock;
+	std::vector<std::unique_ptr<const Filter>> Filters;
+	std::atomic<const Filter *> ActiveFilter;
+
+	Filter::Filter(std::span<const uint64_t> Keys)
+	{
+		// At least two words are needed since a 64-bit shift is undefined
+		const auto wordCount = std::bit_ceil(std::max<size_t>(2, (Keys.size() * BitsPerKey) / 64));
+
+		m_Words.resize(wordCount);
+		m_Shift = 64 - std::countr_zero(wordCount);
+
+		for (const auto key : Keys)
+		{
+			const auto hash = MixKey(key);
+			m_Words[hash >> m_Shift] |= GetBitMask(hash);
+		}
+	}
+
+	double MeasureFalsePositiveRate(const Filter& Target, const std::vector<uint64_t>& SortedKeys)
+	{
+		size_t falsePositives = 0;
+		size_t samples = 0;
+
+		// Technique ids are hashes themselves. Any fixed sequence of pseudo-random ids is representative.
+		for (uint64_t i = 0; i < FalsePositiveSampleCount; i++)
+		{
+			const auto key = Filter::MakeKey(i * 0x9E3779B97F4A7C15ULL, static_cast<uint32_t>(i & 0xFFFF));
+
+			if (std::binary_search(SortedKeys.begin(), SortedKeys.end(), key))
+				continue;
+
+			samples++;
+
+			if (Target.MayContain(key))
+				falsePositives++;
+		}
+
+		return samples > 0 ? static_cast<double>(falsePositives) / samples : 0.0;
+	}
+
+	void Build(std::vector<uint64_t>&& Keys)
+	{
+		std::sort(Keys.begin(), Keys.end());
+		Keys.erase(std::unique(Keys.begin(), Keys.end()), Keys.end());
+
+		auto filter = std::make_unique<const Filter>(Keys);
+
+		spdlog::info(
+			"Replacement filter: {} key(s), {} bytes, {:.3f}% measured false positive rate.",
+			Keys.size(),
+			filter->GetSizeInBytes(),
+			MeasureFalsePositiveRate(*filter, Keys) * 100.0);
+
+		// Lookups run lock-free on the pipeline creation threads and can't be tracked. Replaced filters are kept
+		// alive instead of being freed. They're only rebuilt during live updates.
+		std::scoped_lock lock(FilterLock);
+		ActiveFilter = filter.get();
+		Filters.emplace_back(std::move(filter));
+	}
+
+	bool MayContain(uint64_t TechniqueId, uint32_t Stage)
+	{
+		const auto filter = ActiveFilter.load(std::memory_order_acquire);
+
+		// No filter means nothing was indexed yet. Let the real lookup decide.
+		return !filter || filter->MayContain(Filter::MakeKey(TechniqueId, Stage));
+	}
+}
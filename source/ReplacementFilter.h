@@ -0,0 +1,54 @@
+#pragma once
+
+namespace ReplacementFilter
+{
+	// Bloom filter over every (technique id, stage) pair with a replacement. Almost no techniques are overridden
+	// in practice, so the common case is rejected here before any name formatting or index lookups.
+	class Filter
+	{
+	private:
+		std::vector<uint64_t> m_Words;
+		uint32_t m_Shift = 63;
+
+	public:
+		explicit Filter(std::span<const uint64_t> Keys);
+		Filter(const Filter&) = delete;
+		Filter& operator=(const Filter&) = delete;
+
+		bool MayContain(uint64_t Key) const
+		{
+			const auto hash = MixKey(Key);
+			const auto mask = GetBitMask(hash);
+
+			return (m_Words[hash >> m_Shift] & mask) == mask;
+		}
+
+		size_t GetSizeInBytes() const
+		{
+			return m_Words.size() * sizeof(uint64_t);
+		}
+
+		static uint64_t MakeKey(uint64_t TechniqueId, uint32_t Stage)
+		{
+			return TechniqueId ^ (static_cast<uint64_t>(Stage) << 32) ^ Stage;
+		}
+
+	private:
+		static uint64_t MixKey(uint64_t Key)
+		{
+			// SplitMix64 finalizer
+			Key = (Key ^ (Key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			Key = (Key ^ (Key >> 27)) * 0x94D049BB133111EBULL;
+			return Key ^ (Key >> 31);
+		}
+
+		static uint64_t GetBitMask(uint64_t Hash)
+		{
+			// Four bits within a single 64-bit word keeps each probe to one memory access
+			return (1ull << (Hash & 63)) | (1ull << ((Hash >> 6) & 63)) | (1ull << ((Hash >> 12) & 63)) | (1ull << ((Hash >> 18) & 63));
+		}
+	};
+
+	void Build(std::vector<uint64_t>&& Keys);
+	bool MayContain(uint64_t TechniqueId, uint32_t Stage);
+}
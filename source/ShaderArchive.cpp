@@ -0,0 +1,146 @@
+#include <shared_mutex>
+#include "Platform.h"
+#include "ShaderArchive.h"
+#include "ShaderBinIndex.h"
+
+namespace ShaderArchive
+{
+	struct MountedArchive
+	{
+		std::filesystem::path Path;
+		std::shared_ptr<const void> Owner;
+		Reader ArchiveReader;
+	};
+
+	std::shared_mutex ArchiveLock;
+	std::vector<std::shared_ptr<const MountedArchive>> MountedArchives;
+
+	bool PackDirectory(const std::filesystem::path& SourceDirectory, const std::filesystem::path& ArchivePath)
+	{
+		Writer writer;
+		std::error_code ec;
+
+		for (std::filesystem::recursive_directory_iterator iter(SourceDirectory, std::filesystem::directory_options::skip_permission_denied, ec),
+			 end;
+			 !ec && iter != end;
+			 iter.increment(ec))
+		{
+			// Same layout rules as the loose file index
+			if (iter.depth() < 1)
+				continue;
+
+			iter.disable_recursion_pending();
+
+			if (!iter->is_regular_file(ec))
+				continue;
+
+			try
+			{
+				const auto fileName = iter->path().filename().string();
+				const auto directoryName = iter->path().parent_path().filename().string();
+
+				std::string_view shortName;
+				std::string_view prefix;
+				uint64_t techniqueId = 0;
+
+				if (!ShaderBinIndex::ParseFileName(fileName, shortName, techniqueId, prefix))
+					continue;
+
+				if (shortName.size() != directoryName.size() || _strnicmp(shortName.data(), directoryName.data(), shortName.size()) != 0)
+					continue;
+
+				std::ifstream f(iter->path(), std::ios::binary);
+				const std::vector<uint8_t> data { std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>() };
+
+				if (!data.empty())
+					writer.Add(techniqueId, prefix, data);
+			}
+			catch (const std::system_error&)
+			{
+			}
+		}
+
+		if (ec || !writer.Save(ArchivePath))
+		{
+			spdlog::error("Failed to pack {} into shader archive {}.", SourceDirectory.string(), ArchivePath.string());
+			return false;
+		}
+
+		spdlog::info("Packed {} shader(s) from {} into {}.", writer.GetEntryCount(), SourceDirectory.string(), ArchivePath.string());
+		return true;
+	}
+
+	void MountAll(const std::filesystem::path& RootDirectory)
+	{
+		std::vector<std::filesystem::path> archivePaths;
+		std::vector<std::shared_ptr<const MountedArchive>> newArchives;
+		std::error_code ec;
+
+		for (const auto& entry : std::filesystem::directory_iterator(RootDirectory, ec))
+		{
+			if (entry.is_regular_file(ec) && entry.path().extension() == ".ssa")
+				archivePaths.emplace_back(entry.path());
+		}
+
+		// Archives are searched in alphabetical order and the first match wins
+		std::sort(archivePaths.begin(), archivePaths.end());
+
+		for (const auto& path : archivePaths)
+		{
+			auto archive = std::make_shared<MountedArchive>();
+			archive->Path = path;
+
+			if (!archive->ArchiveReader.Open(ShaderBlobCache::LoadFile(path, archive->Owner)))
+			{
+				spdlog::error("Shader archive {} is invalid or uses an unsupported version.", path.string());
+				continue;
+			}
+
+			// Archives are mapped lazily. Queue reads for the whole file now instead of faulting pages in one at a
+			// time on the pipeline creation threads.
+			Platform::PrefetchMemory(archive->ArchiveReader.GetArchiveData());
+
+			spdlog::info("Mounted shader archive {} with {} entries.", path.string(), archive->ArchiveReader.GetEntries().size());
+			newArchives.emplace_back(std::move(archive));
+		}
+
+		std::unique_lock lock(ArchiveLock);
+		MountedArchives = std::move(newArchives);
+	}
+
+	std::shared_ptr<const ShaderBlobCache::Blob> Find(uint64_t TechniqueId, const char *Prefix)
+	{
+		const auto stage = MakeStageTag(Prefix);
+		std::shared_lock lock(ArchiveLock);
+
+		for (const auto& archive : MountedArchives)
+		{
+			if (auto entry = archive->ArchiveReader.Find(TechniqueId, stage))
+				return std::make_shared<const ShaderBlobCache::Blob>(archive->Owner, archive->ArchiveReader.GetData(*entry), entry->ContentHash);
+		}
+
+		return nullptr;
+	}
+
+	size_t GetEntryCount()
+	{
+		std::shared_lock lock(ArchiveLock);
+		size_t count = 0;
+
+		for (const auto& archive : MountedArchives)
+			count += archive->ArchiveReader.GetEntries().size();
+
+		return count;
+	}
+
+	void ForEachEntry(const std::function<void(uint64_t TechniqueId, uint32_t Stage)>& Callback)
+	{
+		std::shared_lock lock(ArchiveLock);
+
+		for (const auto& archive : MountedArchives)
+		{
+			for (const auto& entry : archive->ArchiveReader.GetEntries())
+				Callback(entry.TechniqueId, entry.Stage);
+		}
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "ShaderArchiveFormat.h"
+#include "ShaderBlobCache.h"
+
+namespace ShaderArchive
+{
+	bool PackDirectory(const std::filesystem::path& SourceDirectory, const std::filesystem::path& ArchivePath);
+	void MountAll(const std::filesystem::path& RootDirectory);
+	std::shared_ptr<const ShaderBlobCache::Blob> Find(uint64_t TechniqueId, const char *Prefix);
+	size_t GetEntryCount();
+	void ForEachEntry(const std::function<void(uint64_t TechniqueId, uint32_t Stage)>& Callback);
+}
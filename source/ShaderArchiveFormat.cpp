@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <tuple>
+#include <unordered_map>
+#include "Hashing.h"
+#include "ShaderArchiveFormat.h"
+
+namespace ShaderArchive
+{
+	uint64_t AlignUp(uint64_t X, uint64_t A)
+	{
+		return (X + (A - 1)) & ~(A - 1);
+	}
+
+	uint32_t MakeStageTag(std::string_view Prefix)
+	{
+		// Up to four lowercase characters packed into an integer: "vs" => 0x00007376
+		uint32_t tag = 0;
+
+		for (size_t i = 0; i < std::min<size_t>(Prefix.size(), sizeof(tag)); i++)
+			tag |= static_cast<uint32_t>(std::tolower(static_cast<unsigned char>(Prefix[i]))) << (i * 8);
+
+		return tag;
+	}
+
+	void Writer::Add(uint64_t TechniqueId, std::string_view Prefix, std::span<const uint8_t> Data)
+	{
+		m_Blobs.insert_or_assign({ TechniqueId, MakeStageTag(Prefix) }, std::vector<uint8_t>(Data.begin(), Data.end()));
+	}
+
+	bool Writer::Save(const std::filesystem::path& Path) const
+	{
+		// std::map iteration order is already sorted by (TechniqueId, Stage)
+		std::vector<ArchiveEntry> entries;
+		std::vector<std::span<const uint8_t>> uniqueBlobs;
+		std::unordered_multimap<uint64_t, size_t> hashToEntry;
+
+		entries.reserve(m_Blobs.size());
+		auto offset = AlignUp(sizeof(ArchiveHeader) + (m_Blobs.size() * sizeof(ArchiveEntry)), BlobAlignment);
+
+		for (const auto& [key, data] : m_Blobs)
+		{
+			auto& entry = entries.emplace_back(ArchiveEntry {
+				.TechniqueId = key.first,
+				.Stage = key.second,
+				.Reserved = 0,
+				.Offset = 0,
+				.Size = data.size(),
+				.ContentHash = Hashing::ComputeContentHash(data),
+			});
+
+			const auto [begin, end] = hashToEntry.equal_range(entry.ContentHash);
+			const auto existing = std::find_if(
+				begin,
+				end,
+				[&](const auto& Pair)
+				{
+					const auto& other = entries[Pair.second];
+					return other.Size == data.size() && memcmp(uniqueBlobs[other.Reserved].data(), data.data(), data.size()) == 0;
+				});
+
+			if (existing != end)
+			{
+				entry.Offset = entries[existing->second].Offset;
+				entry.Reserved = entries[existing->second].Reserved;
+			}
+			else
+			{
+				// Reserved temporarily holds the unique blob index. It's cleared before writing.
+				entry.Offset = offset;
+				entry.Reserved = static_cast<uint32_t>(uniqueBlobs.size());
+
+				offset = AlignUp(offset + data.size(), BlobAlignment);
+				uniqueBlobs.emplace_back(data);
+				hashToEntry.emplace(entry.ContentHash, entries.size() - 1);
+			}
+		}
+
+		for (auto& entry : entries)
+			entry.Reserved = 0;
+
+		std::ofstream f(Path, std::ios::binary | std::ios::trunc);
+
+		if (!f.good())
+			return false;
+
+		const ArchiveHeader header {
+			.Magic = ArchiveMagic,
+			.Version = ArchiveVersion,
+			.EntryCount = static_cast<uint32_t>(entries.size()),
+			.Reserved = 0,
+		};
+
+		const auto writePadding = [&]()
+		{
+			constexpr char zeroes[BlobAlignment] = {};
+			const auto position = static_cast<uint64_t>(f.tellp());
+
+			f.write(zeroes, AlignUp(position, BlobAlignment) - position);
+		};
+
+		f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		f.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(ArchiveEntry));
+		writePadding();
+
+		for (const auto& blob : uniqueBlobs)
+		{
+			f.write(reinterpret_cast<const char *>(blob.data()), blob.size());
+			writePadding();
+		}
+
+		return f.good();
+	}
+
+	size_t Writer::GetEntryCount() const
+	{
+		return m_Blobs.size();
+	}
+
+	bool Reader::Open(std::span<const uint8_t> Data)
+	{
+		m_Data = {};
+		m_Entries = {};
+
+		if (Data.size() < sizeof(ArchiveHeader))
+			return false;
+
+		const auto header = reinterpret_cast<const ArchiveHeader *>(Data.data());
+
+		if (header->Magic != ArchiveMagic || header->Version != ArchiveVersion)
+			return false;
+
+		if (header->EntryCount > (Data.size() - sizeof(ArchiveHeader)) / sizeof(ArchiveEntry))
+			return false;
+
+		const std::span entries(reinterpret_cast<const ArchiveEntry *>(Data.data() + sizeof(ArchiveHeader)), header->EntryCount);
+
+		// Reject anything pointing outside of the file or breaking the sort order binary searches rely on
+		for (const auto& entry : entries)
+		{
+			if (entry.Offset > Data.size() || entry.Size > Data.size() - entry.Offset)
+				return false;
+		}
+
+		const auto isSorted = std::is_sorted(
+			entries.begin(),
+			entries.end(),
+			[](const ArchiveEntry& A, const ArchiveEntry& B)
+			{
+				return std::tie(A.TechniqueId, A.Stage) < std::tie(B.TechniqueId, B.Stage);
+			});
+
+		if (!isSorted)
+			return false;
+
+		m_Data = Data;
+		m_Entries = entries;
+		return true;
+	}
+
+	const ArchiveEntry *Reader::Find(uint64_t TechniqueId, uint32_t Stage) const
+	{
+		const auto itr = std::lower_bound(
+			m_Entries.begin(),
+			m_Entries.end(),
+			std::make_pair(TechniqueId, Stage),
+			[](const ArchiveEntry& Entry, const std::pair<uint64_t, uint32_t>& Key)
+			{
+				return std::tie(Entry.TechniqueId, Entry.Stage) < std::tie(Key.first, Key.second);
+			});
+
+		if (itr == m_Entries.end() || itr->TechniqueId != TechniqueId || itr->Stage != Stage)
+			return nullptr;
+
+		return &*itr;
+	}
+
+	std::span<const uint8_t> Reader::GetData(const ArchiveEntry& Entry) const
+	{
+		return m_Data.subspan(Entry.Offset, Entry.Size);
+	}
+}
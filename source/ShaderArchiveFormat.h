@@ -0,0 +1,80 @@
+#pragma once
+
+// Archive format, writer and reader only. Kept free of Win32 and the precompiled header so archives can be
+// produced and checked by tools outside the game.
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ShaderArchive
+{
+	//
+	// Single-file alternative to the loose shadersfx layout. All values are little endian.
+	//
+	// [ArchiveHeader]
+	// [ArchiveEntry * EntryCount]	Sorted by TechniqueId, then Stage
+	// [Blob data]					Each blob starts on a BlobAlignment boundary. Identical blobs are stored once.
+	//
+	constexpr uint32_t ArchiveMagic = 0x41495353; // "SSIA"
+	constexpr uint32_t ArchiveVersion = 1;
+	constexpr uint64_t BlobAlignment = 16;
+
+	struct ArchiveHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t EntryCount;
+		uint32_t Reserved;
+	};
+	static_assert(sizeof(ArchiveHeader) == 0x10);
+
+	struct ArchiveEntry
+	{
+		uint64_t TechniqueId;
+		uint32_t Stage; // See MakeStageTag()
+		uint32_t Reserved;
+		uint64_t Offset; // Relative to the start of the archive
+		uint64_t Size;
+		uint64_t ContentHash;
+	};
+	static_assert(sizeof(ArchiveEntry) == 0x28);
+
+	uint32_t MakeStageTag(std::string_view Prefix);
+
+	class Writer
+	{
+	private:
+		std::map<std::pair<uint64_t, uint32_t>, std::vector<uint8_t>> m_Blobs;
+
+	public:
+		void Add(uint64_t TechniqueId, std::string_view Prefix, std::span<const uint8_t> Data);
+		bool Save(const std::filesystem::path& Path) const;
+		size_t GetEntryCount() const;
+	};
+
+	class Reader
+	{
+	private:
+		std::span<const uint8_t> m_Data;
+		std::span<const ArchiveEntry> m_Entries;
+
+	public:
+		bool Open(std::span<const uint8_t> Data);
+		const ArchiveEntry *Find(uint64_t TechniqueId, uint32_t Stage) const;
+		std::span<const uint8_t> GetData(const ArchiveEntry& Entry) const;
+
+		std::span<const ArchiveEntry> GetEntries() const
+		{
+			return m_Entries;
+		}
+
+		std::span<const uint8_t> GetArchiveData() const
+		{
+			return m_Data;
+		}
+	};
+}
@@ -0,0 +1,130 @@
+#include <charconv>
+#include <shared_mutex>
+#include "ShaderBinIndex.h"
+
+namespace ShaderBinIndex
+{
+	struct IndexEntry
+	{
+		std::string TechniqueShortName;
+		std::string Prefix;
+		std::filesystem::path Path;
+	};
+
+	std::shared_mutex IndexLock;
+	std::unordered_multimap<uint64_t, IndexEntry> Index;
+
+	bool ParseFileName(std::string_view FileName, std::string_view& TechniqueShortName, uint64_t& TechniqueId, std::string_view& Prefix)
+	{
+		// <TechniqueShortName>_<TechniqueId>_<Prefix>.bin. Technique names are allowed to contain underscores
+		// so parsing has to start from the end.
+		if (FileName.size() <= 4 || _strnicmp(FileName.data() + FileName.size() - 4, ".bin", 4) != 0)
+			return false;
+
+		FileName.remove_suffix(4);
+
+		const auto prefixStart = FileName.rfind('_');
+
+		if (prefixStart == std::string_view::npos || prefixStart == 0)
+			return false;
+
+		const auto idStart = FileName.rfind('_', prefixStart - 1);
+
+		if (idStart == std::string_view::npos || idStart == 0)
+			return false;
+
+		const auto idString = FileName.substr(idStart + 1, prefixStart - idStart - 1);
+		const auto result = std::from_chars(idString.data(), idString.data() + idString.size(), TechniqueId, 16);
+
+		if (result.ec != std::errc() || result.ptr != idString.data() + idString.size())
+			return false;
+
+		TechniqueShortName = FileName.substr(0, idStart);
+		Prefix = FileName.substr(prefixStart + 1);
+		return !Prefix.empty();
+	}
+
+	void Build(const std::filesystem::path& RootDirectory)
+	{
+		std::unordered_multimap<uint64_t, IndexEntry> newIndex;
+		std::error_code ec;
+
+		for (std::filesystem::recursive_directory_iterator iter(RootDirectory, std::filesystem::directory_options::skip_permission_denied, ec),
+			 end;
+			 !ec && iter != end;
+			 iter.increment(ec))
+		{
+			// Only <Root>\<TechniqueShortName>\<File>.bin is a valid location. Anything deeper is ignored.
+			if (iter.depth() < 1)
+				continue;
+
+			iter.disable_recursion_pending();
+
+			if (!iter->is_regular_file(ec))
+				continue;
+
+			try
+			{
+				const auto fileName = iter->path().filename().string();
+				const auto directoryName = iter->path().parent_path().filename().string();
+
+				std::string_view shortName;
+				std::string_view prefix;
+				uint64_t techniqueId = 0;
+
+				if (!ParseFileName(fileName, shortName, techniqueId, prefix))
+					continue;
+
+				if (shortName.size() != directoryName.size() || _strnicmp(shortName.data(), directoryName.data(), shortName.size()) != 0)
+					continue;
+
+				newIndex.emplace(
+					techniqueId,
+					IndexEntry {
+						.TechniqueShortName = std::string(shortName),
+						.Prefix = std::string(prefix),
+						.Path = iter->path(),
+					});
+			}
+			catch (const std::system_error&)
+			{
+				// File names that can't be represented in the current code page aren't valid shader names
+			}
+		}
+
+		if (ec)
+			spdlog::warn("Shader index: Failed to enumerate {}: {}", RootDirectory.string(), ec.message());
+
+		std::unique_lock lock(IndexLock);
+		Index = std::move(newIndex);
+	}
+
+	std::optional<std::filesystem::path> Find(const char *TechniqueShortName, uint64_t TechniqueId, const char *Prefix)
+	{
+		std::shared_lock lock(IndexLock);
+		const auto [begin, end] = Index.equal_range(TechniqueId);
+
+		for (auto itr = begin; itr != end; itr++)
+		{
+			if (_stricmp(itr->second.Prefix.c_str(), Prefix) == 0 && _stricmp(itr->second.TechniqueShortName.c_str(), TechniqueShortName) == 0)
+				return itr->second.Path;
+		}
+
+		return std::nullopt;
+	}
+
+	size_t GetEntryCount()
+	{
+		std::shared_lock lock(IndexLock);
+		return Index.size();
+	}
+
+	void ForEachEntry(
+		const std::function<void(uint64_t TechniqueId, std::string_view Prefix, const std::filesystem::path& Path)>& Callback)
+	{
+		std::shared_lock lock(IndexLock);
+
+		for (const auto& [techniqueId, entry] : Index)
+			Callback(techniqueId, entry.Prefix, entry.Path);
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+namespace ShaderBinIndex
+{
+	// In-memory view of the custom shader directory. File names follow the
+	// <TechniqueShortName>\<TechniqueShortName>_<TechniqueId>_<Prefix>.bin layout and are parsed once up front so
+	// that techniques without a replacement never touch the filesystem.
+	bool ParseFileName(std::string_view FileName, std::string_view& TechniqueShortName, uint64_t& TechniqueId, std::string_view& Prefix);
+	void Build(const std::filesystem::path& RootDirectory);
+
+	std::optional<std::filesystem::path> Find(const char *TechniqueShortName, uint64_t TechniqueId, const char *Prefix);
+	size_t GetEntryCount();
+	void ForEachEntry(
+		const std::function<void(uint64_t TechniqueId, std::string_view Prefix, const std::filesystem::path& Path)>& Callback);
+}
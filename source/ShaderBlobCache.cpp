@@ -0,0 +1,260 @@
+#include <condition_variable>
+#include "Hashing.h"
+#include "LoadStatistics.h"
+#include "Platform.h"
+#include "Plugin.h"
+#include "ShaderBlobCache.h"
+
+namespace ShaderBlobCache
+{
+	constexpr uint32_t MaxPrefetchThreads = 4;
+
+	struct CacheEntry
+	{
+		std::shared_ptr<const Blob> Contents;
+		bool PrefetchedAndUnused = false; // Cleared by the first Acquire() so only that lookup counts as a hit
+	};
+
+	struct PrefetchState
+	{
+		std::vector<std::filesystem::path> Paths;
+		std::atomic_size_t NextIndex;
+		std::atomic_bool Cancelled;
+		uint32_t ActiveThreads = 0; // Guarded by PrefetchLock
+		std::chrono::steady_clock::time_point StartTime;
+	};
+
+	std::mutex CacheLock;
+	std::unordered_map<std::filesystem::path::string_type, CacheEntry> Cache;
+	std::unordered_multimap<uint64_t, std::shared_ptr<const Blob>> ContentCache;
+	Statistics CacheStatistics;
+
+	// Game shaders retained for live updates. Unlike the file cache this is never cleared since tracked pipelines
+	// live for the whole session.
+	std::mutex InternLock;
+	std::unordered_multimap<uint64_t, std::shared_ptr<const Blob>> InternedBlobs;
+	InternStatistics InternedStatistics;
+
+	// Workers must be gone before the cache is cleared. Otherwise a file read before a live update could be
+	// inserted after it and shadow the new contents.
+	std::mutex PrefetchLock;
+	std::condition_variable PrefetchCondition;
+	std::shared_ptr<PrefetchState> ActivePrefetch;
+
+	Blob::Blob(std::shared_ptr<const void> Owner, std::span<const uint8_t> Data, uint64_t Hash) :
+		m_Owner(std::move(Owner)),
+		m_Data(Data),
+		m_Hash(Hash)
+	{
+	}
+
+	std::span<const uint8_t> LoadFile(const std::filesystem::path& Path, std::shared_ptr<const void>& Owner)
+	{
+		// Editors and dxc.exe can't overwrite a file while a view of it is mapped. Live updates have to fall back to
+		// reading a private copy.
+		std::error_code ec;
+		const auto data = Platform::LoadFile(Path, Plugin::AllowLiveUpdates, Owner, ec);
+
+		// Zero-length files aren't valid shaders either
+		if (data.empty())
+			spdlog::warn("Failed to load shader file {}. Error code {:X}.", Path.string(), static_cast<uint32_t>(ec.value()));
+
+		return data;
+	}
+
+	std::shared_ptr<const Blob> AcquireBlob(const std::filesystem::path& Path, bool IsPrefetch)
+	{
+		{
+			std::scoped_lock lock(CacheLock);
+
+			if (auto itr = Cache.find(Path.native()); itr != Cache.end())
+			{
+				if (!IsPrefetch && std::exchange(itr->second.PrefetchedAndUnused, false))
+					CacheStatistics.CacheHitCount++;
+
+				return itr->second.Contents;
+			}
+
+			if (!IsPrefetch)
+				CacheStatistics.CacheMissCount++;
+		}
+
+		// Load and hash outside of the lock. If two threads race on the same file, the first one to insert wins
+		// and the other copy is discarded.
+		std::shared_ptr<const void> owner;
+		std::optional<LoadStatistics::ScopedPhaseTimer> timer;
+
+		// Prefetch threads aren't creating pipelines
+		if (!IsPrefetch)
+			timer.emplace(LoadStatistics::Phase::FileRead);
+
+		const auto fileData = LoadFile(Path, owner);
+
+		if (fileData.empty())
+			return nullptr;
+
+		auto blob = std::make_shared<const Blob>(std::move(owner), fileData, Hashing::ComputeContentHash(fileData));
+		timer.reset();
+
+		std::scoped_lock lock(CacheLock);
+
+		if (auto itr = Cache.find(Path.native()); itr != Cache.end())
+			return itr->second.Contents;
+
+		// Mods tend to ship the same bytecode under many technique names. Keep only the first copy of each
+		// unique blob and let every other file reference it.
+		const auto data = blob->GetData();
+		const auto [begin, end] = ContentCache.equal_range(blob->GetHash());
+
+		CacheStatistics.TotalBlobCount++;
+		CacheStatistics.TotalBytes += data.size();
+
+		auto existing = std::find_if(
+			begin,
+			end,
+			[&](const auto& Pair)
+			{
+				const auto other = Pair.second->GetData();
+				return other.size() == data.size() && memcmp(other.data(), data.data(), data.size()) == 0;
+			});
+
+		if (existing != end)
+		{
+			blob = existing->second;
+		}
+		else
+		{
+			ContentCache.emplace(blob->GetHash(), blob);
+
+			CacheStatistics.UniqueBlobCount++;
+			CacheStatistics.UniqueBytes += data.size();
+		}
+
+		return Cache.emplace(Path.native(), CacheEntry { .Contents = std::move(blob), .PrefetchedAndUnused = IsPrefetch }).first->second.Contents;
+	}
+
+	std::shared_ptr<const Blob> Acquire(const std::filesystem::path& Path)
+	{
+		return AcquireBlob(Path, false);
+	}
+
+	void Prefetch(std::vector<std::filesystem::path>&& Paths)
+	{
+		if (Paths.empty())
+			return;
+
+		CancelPrefetch();
+
+		auto state = std::make_shared<PrefetchState>();
+		state->Paths = std::move(Paths);
+		state->StartTime = std::chrono::steady_clock::now();
+
+		// Disk bound work. A handful of threads is enough to keep the I/O queue full.
+		const auto threadCount = std::clamp<uint32_t>(std::thread::hardware_concurrency() / 2, 1, MaxPrefetchThreads);
+		state->ActiveThreads = threadCount;
+
+		{
+			std::scoped_lock lock(PrefetchLock);
+			ActivePrefetch = state;
+		}
+
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			std::thread(
+				[state]()
+				{
+					for (size_t index; !state->Cancelled && (index = state->NextIndex++) < state->Paths.size();)
+						AcquireBlob(state->Paths[index], true);
+
+					std::scoped_lock lock(PrefetchLock);
+
+					// Last thread out reports the results
+					if (--state->ActiveThreads == 0)
+					{
+						if (ActivePrefetch == state)
+							ActivePrefetch.reset();
+
+						const auto end = std::chrono::steady_clock::now();
+
+						spdlog::info(
+							"Prefetched {} of {} replacement file(s) in {} ms.",
+							std::min(state->NextIndex.load(), state->Paths.size()),
+							state->Paths.size(),
+							std::chrono::duration_cast<std::chrono::milliseconds>(end - state->StartTime).count());
+
+						PrefetchCondition.notify_all();
+					}
+				})
+				.detach();
+		}
+	}
+
+	void CancelPrefetch()
+	{
+		std::unique_lock lock(PrefetchLock);
+		const auto state = ActivePrefetch;
+
+		if (!state)
+			return;
+
+		// Files already being read are finished, everything else is skipped
+		state->Cancelled = true;
+		PrefetchCondition.wait(lock, [&] { return state->ActiveThreads == 0; });
+	}
+
+	std::shared_ptr<const Blob> Intern(std::span<const uint8_t> Data)
+	{
+		if (Data.empty())
+			return nullptr;
+
+		const auto hash = Hashing::ComputeContentHash(Data);
+		std::scoped_lock lock(InternLock);
+
+		InternedStatistics.ReferenceCount++;
+		InternedStatistics.ReferencedBytes += Data.size();
+
+		const auto [begin, end] = InternedBlobs.equal_range(hash);
+
+		for (auto itr = begin; itr != end; itr++)
+		{
+			const auto other = itr->second->GetData();
+
+			if (other.size() == Data.size() && memcmp(other.data(), Data.data(), Data.size()) == 0)
+				return itr->second;
+		}
+
+		auto heapData = std::make_shared_for_overwrite<uint8_t[]>(Data.size());
+		memcpy(heapData.get(), Data.data(), Data.size());
+
+		const std::span<const uint8_t> data(heapData.get(), Data.size());
+		auto blob = std::make_shared<const Blob>(std::move(heapData), data, hash);
+
+		InternedStatistics.UniqueBlobCount++;
+		InternedStatistics.UniqueBytes += Data.size();
+
+		return InternedBlobs.emplace(hash, std::move(blob))->second;
+	}
+
+	void Clear()
+	{
+		CancelPrefetch();
+
+		// Pipeline streams still holding a reference keep their blob alive
+		std::scoped_lock lock(CacheLock);
+		Cache.clear();
+		ContentCache.clear();
+		CacheStatistics = {};
+	}
+
+	Statistics GetStatistics()
+	{
+		std::scoped_lock lock(CacheLock);
+		return CacheStatistics;
+	}
+
+	InternStatistics GetInternStatistics()
+	{
+		std::scoped_lock lock(InternLock);
+		return InternedStatistics;
+	}
+}
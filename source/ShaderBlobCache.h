@@ -0,0 +1,56 @@
+#pragma once
+
+namespace ShaderBlobCache
+{
+	// Read-only view of a replacement file. Blobs are shared between every pipeline stream that references them
+	// and the backing memory is released once the last reference goes away.
+	class Blob
+	{
+	private:
+		std::shared_ptr<const void> m_Owner; // File mapping or heap allocation backing m_Data
+		std::span<const uint8_t> m_Data;
+		uint64_t m_Hash = 0;
+
+	public:
+		Blob(std::shared_ptr<const void> Owner, std::span<const uint8_t> Data, uint64_t Hash);
+		Blob(const Blob&) = delete;
+		Blob& operator=(const Blob&) = delete;
+
+		std::span<const uint8_t> GetData() const
+		{
+			return m_Data;
+		}
+
+		uint64_t GetHash() const
+		{
+			return m_Hash;
+		}
+	};
+
+	struct Statistics
+	{
+		size_t TotalBlobCount = 0;  // Files loaded
+		size_t UniqueBlobCount = 0; // Distinct contents kept in memory
+		size_t TotalBytes = 0;
+		size_t UniqueBytes = 0;
+		size_t CacheHitCount = 0;  // Files that prefetching had already loaded by the time they were first needed
+		size_t CacheMissCount = 0; // Lookups that fell back to a synchronous read
+	};
+
+	struct InternStatistics
+	{
+		size_t ReferenceCount = 0; // Intern() calls
+		size_t UniqueBlobCount = 0;
+		size_t ReferencedBytes = 0; // Bytes that would be held if every caller kept a private copy
+		size_t UniqueBytes = 0;
+	};
+
+	std::span<const uint8_t> LoadFile(const std::filesystem::path& Path, std::shared_ptr<const void>& Owner);
+	std::shared_ptr<const Blob> Acquire(const std::filesystem::path& Path);
+	void Prefetch(std::vector<std::filesystem::path>&& Paths);
+	void CancelPrefetch(); // Blocks until every prefetch thread has exited. Clear() calls this.
+	std::shared_ptr<const Blob> Intern(std::span<const uint8_t> Data);
+	void Clear();
+	Statistics GetStatistics();
+	InternStatistics GetInternStatistics();
+}
@@ -0,0 +1,589 @@
+#include <charconv>
+#include <deque>
+#include <unordered_set>
+#include "Hashing.h"
+#include "Plugin.h"
+#include "ShaderDumpWriter.h"
+
+namespace ShaderDumpWriter
+{
+	constexpr size_t CsvBufferSize = 1024 * 1024;
+	constexpr size_t MaxPendingBytes = 64 * 1024 * 1024; // Bytecode copies waiting for the writer thread
+	constexpr const char *BlobDirectoryName = "Blobs";
+	constexpr const char *ManifestFileName = "ShaderManifest.csv";
+	constexpr const char *DeltaReportFileName = "ShaderDumpDelta.csv";
+	constexpr uint64_t CheckHashSeed = 0x53534944554D5031; // Anything but zero
+
+	struct alignas(MEMORY_ALLOCATION_ALIGNMENT) DumpRequest
+	{
+		SLIST_ENTRY Entry; // Must be the first member
+		bool IsCheckpoint = false;
+		std::string TechniqueShortName;
+		std::string Prefix;
+		uint64_t TechniqueId = 0;
+		std::string TechniqueName;
+		std::vector<uint8_t> Bytecode;
+	};
+	static_assert(offsetof(DumpRequest, Entry) == 0);
+
+	struct DumpedBlob
+	{
+		size_t Size = 0;
+		uint64_t CheckHash = 0; // Independent second hash used to tell content hash collisions apart
+	};
+
+	// (TechniqueShortName, Prefix, TechniqueId)
+	using ManifestKey = std::tuple<std::string, std::string, uint64_t>;
+
+	struct ManifestEntry
+	{
+		uint64_t ContentHash = 0;
+		std::string Blob; // Empty for regular dumps
+		std::string TechniqueName;
+	};
+
+	struct WriterState
+	{
+		std::unordered_set<std::string> CreatedDirectories;
+		std::unordered_map<uint64_t, std::vector<DumpedBlob>> DumpedBlobs;
+		std::map<ManifestKey, ManifestEntry> PreviousManifest; // Left behind by the last run. Never modified.
+		std::map<ManifestKey, ManifestEntry> CurrentManifest;  // Everything seen during this run
+		std::ofstream Csv;
+		size_t WrittenCount = 0;
+		size_t SkippedCount = 0;
+	};
+
+	SLIST_HEADER PendingRequests;
+	HANDLE PendingRequestsEvent;
+
+	// Producers block once the writer falls this far behind instead of letting copies pile up without limit
+	std::atomic_size_t PendingBytes;
+	std::atomic_long BlockedProducers;
+	HANDLE PendingBytesSemaphore;
+
+	// Owned by the writer thread
+	WriterState Writer;
+	std::deque<std::unique_ptr<DumpRequest>> Backlog; // Taken off PendingRequests but not written yet
+
+	bool ParseManifestLine(std::string_view Line, ManifestKey& Key, ManifestEntry& Entry)
+	{
+		// <TechniqueShortName>,<Prefix>,<TechniqueId>,<ContentHash>,<Blob>,"<TechniqueName>"
+		std::string_view fields[5];
+
+		for (auto& field : fields)
+		{
+			const auto separator = Line.find(',');
+
+			if (separator == std::string_view::npos)
+				return false;
+
+			field = Line.substr(0, separator);
+			Line.remove_prefix(separator + 1);
+		}
+
+		if (fields[0].empty() || fields[1].empty() || Line.size() < 2 || Line.front() != '"' || Line.back() != '"')
+			return false;
+
+		uint64_t techniqueId = 0;
+		uint64_t contentHash = 0;
+
+		for (auto [field, value] : { std::make_pair(fields[2], &techniqueId), std::make_pair(fields[3], &contentHash) })
+		{
+			const auto result = std::from_chars(field.data(), field.data() + field.size(), *value, 16);
+
+			if (result.ec != std::errc() || result.ptr != field.data() + field.size())
+				return false;
+		}
+
+		Key = { std::string(fields[0]), std::string(fields[1]), techniqueId };
+		Entry = {
+			.ContentHash = contentHash,
+			.Blob = std::string(fields[4]),
+			.TechniqueName = std::string(Line.substr(1, Line.size() - 2)),
+		};
+
+		return true;
+	}
+
+	std::map<ManifestKey, ManifestEntry> LoadManifest(const std::filesystem::path& Path)
+	{
+		std::map<ManifestKey, ManifestEntry> manifest;
+		std::ifstream f(Path);
+
+		for (std::string line; std::getline(f, line);)
+		{
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			ManifestKey key;
+			ManifestEntry entry;
+
+			if (!ParseManifestLine(line, key, entry))
+			{
+				spdlog::warn("Skipping malformed shader manifest line: {}", line);
+				continue;
+			}
+
+			manifest.insert_or_assign(std::move(key), std::move(entry));
+		}
+
+		return manifest;
+	}
+
+	void SaveManifest(const std::filesystem::path& Path, const std::map<ManifestKey, ManifestEntry>& Manifest)
+	{
+		// Write to a temporary file first. A crash halfway through must not destroy the previous manifest.
+		auto tempPath = Path;
+		tempPath += ".tmp";
+
+		{
+			static char manifestBuffer[CsvBufferSize];
+			std::ofstream f;
+			f.rdbuf()->pubsetbuf(manifestBuffer, sizeof(manifestBuffer));
+			f.open(tempPath, std::ios::trunc);
+
+			if (!f.good())
+				return;
+
+			f << "# TechniqueShortName,Prefix,TechniqueId,ContentHash,Blob,TechniqueName\n";
+
+			for (const auto& [key, entry] : Manifest)
+			{
+				const auto& [techniqueShortName, prefix, techniqueId] = key;
+
+				char line[2048];
+				auto length = sprintf_s(
+					line,
+					"%s,%s,%llX,%016llX,%s,\"%s\"\n",
+					techniqueShortName.c_str(),
+					prefix.c_str(),
+					techniqueId,
+					entry.ContentHash,
+					entry.Blob.c_str(),
+					entry.TechniqueName.c_str());
+
+				f.write(line, length);
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(tempPath, Path, ec);
+
+		if (ec)
+			spdlog::error("Failed to save shader manifest {}: {}", Path.string(), ec.message());
+	}
+
+	std::string GetBlobName(uint64_t ContentHash, size_t CollisionIndex)
+	{
+		char name[64];
+
+		if (CollisionIndex == 0)
+			sprintf_s(name, "%016llX", ContentHash);
+		else
+			sprintf_s(name, "%016llX_%llu", ContentHash, static_cast<uint64_t>(CollisionIndex));
+
+		return name;
+	}
+
+	std::filesystem::path GetBlobPath(const std::filesystem::path& DumpDirectory, const std::string& BlobName)
+	{
+		return DumpDirectory / BlobDirectoryName / (BlobName + ".bin");
+	}
+
+	std::filesystem::path GetShaderBinPath(const std::filesystem::path& DumpDirectory, const ManifestKey& Key)
+	{
+		const auto& [techniqueShortName, prefix, techniqueId] = Key;
+
+		char shaderBinFileName[512];
+		sprintf_s(shaderBinFileName, "%s_%llX_%s.bin", techniqueShortName.c_str(), techniqueId, prefix.c_str());
+
+		return DumpDirectory / techniqueShortName / shaderBinFileName;
+	}
+
+	bool WriteFile(const std::filesystem::path& Path, std::span<const uint8_t> Data)
+	{
+		std::ofstream f(Path, std::ios::binary);
+
+		if (!f.good())
+			return false;
+
+		f.write(reinterpret_cast<const char *>(Data.data()), Data.size());
+		return f.good();
+	}
+
+	std::string WriteDeduplicatedBlob(const DumpRequest& Request, uint64_t ContentHash, WriterState& State)
+	{
+		const auto checkHash = Hashing::ComputeContentHash(Request.Bytecode, CheckHashSeed);
+		auto& candidates = State.DumpedBlobs[ContentHash];
+
+		for (size_t i = 0; i < candidates.size(); i++)
+		{
+			if (candidates[i].Size == Request.Bytecode.size() && candidates[i].CheckHash == checkHash)
+				return GetBlobName(ContentHash, i);
+		}
+
+		// First time this content is seen. Colliding contents get a numbered suffix.
+		const auto blobName = GetBlobName(ContentHash, candidates.size());
+		candidates.emplace_back(DumpedBlob { .Size = Request.Bytecode.size(), .CheckHash = checkHash });
+
+		std::error_code ec;
+
+		if (State.CreatedDirectories.emplace(BlobDirectoryName).second)
+			std::filesystem::create_directories(Plugin::ShaderDumpBinPath / BlobDirectoryName, ec);
+
+		// Blobs left behind by an earlier run are named after their contents and don't need to be rewritten
+		const auto blobPath = GetBlobPath(Plugin::ShaderDumpBinPath, blobName);
+
+		if (candidates.size() == 1 && std::filesystem::file_size(blobPath, ec) == Request.Bytecode.size() && !ec)
+			return blobName;
+
+		WriteFile(blobPath, Request.Bytecode);
+		return blobName;
+	}
+
+	void WriteRequest(const DumpRequest& Request, WriterState& State)
+	{
+		ManifestKey key { Request.TechniqueShortName, Request.Prefix, Request.TechniqueId };
+		const auto contentHash = Hashing::ComputeContentHash(Request.Bytecode);
+
+		// Skip anything already written by this run or left unchanged since the previous one
+		const auto isUpToDate = [&](const std::map<ManifestKey, ManifestEntry>& Manifest)
+		{
+			const auto itr = Manifest.find(key);
+
+			if (itr == Manifest.end() || itr->second.ContentHash != contentHash)
+				return false;
+
+			// The dump mode might have changed in between runs. Files might also have been deleted by hand.
+			if (Plugin::DeduplicateShaderDump)
+				return !itr->second.Blob.empty() && std::filesystem::exists(GetBlobPath(Plugin::ShaderDumpBinPath, itr->second.Blob));
+
+			return itr->second.Blob.empty() && std::filesystem::exists(GetShaderBinPath(Plugin::ShaderDumpBinPath, key));
+		};
+
+		if (auto itr = State.CurrentManifest.find(key); itr != State.CurrentManifest.end() && itr->second.ContentHash == contentHash)
+		{
+			State.SkippedCount++;
+			return;
+		}
+
+		if (isUpToDate(State.PreviousManifest))
+		{
+			auto previousEntry = State.PreviousManifest.at(key);
+			State.CurrentManifest.insert_or_assign(std::move(key), std::move(previousEntry));
+			State.SkippedCount++;
+			return;
+		}
+
+		const auto hash = Hashing::FNV1A32(Request.Bytecode.data(), Request.Bytecode.size());
+		std::string blobName;
+
+		if (Plugin::DeduplicateShaderDump)
+		{
+			// Identical bytecode is stored once and the manifest records which blob each technique uses
+			blobName = WriteDeduplicatedBlob(Request, contentHash, State);
+		}
+		else
+		{
+			const auto shaderBinFullPath = GetShaderBinPath(Plugin::ShaderDumpBinPath, key);
+
+			// Thousands of shaders share a handful of technique directories
+			if (std::error_code ec; State.CreatedDirectories.emplace(Request.TechniqueShortName).second)
+				std::filesystem::create_directories(shaderBinFullPath.parent_path(), ec);
+
+			spdlog::info("Dumping shader with hash {} to {}", hash, shaderBinFullPath.string());
+
+			// Dump binary
+			WriteFile(shaderBinFullPath, Request.Bytecode);
+		}
+
+		State.CurrentManifest.insert_or_assign(
+			std::move(key),
+			ManifestEntry {
+				.ContentHash = contentHash,
+				.Blob = std::move(blobName),
+				.TechniqueName = Request.TechniqueName,
+			});
+
+		State.WrittenCount++;
+
+		// Append to CSV
+		if (State.Csv.good())
+		{
+			char csvLine[2048];
+			auto length = sprintf_s(
+				csvLine,
+				"%s,%s,%u,%llX,\"%s\"\n",
+				Request.TechniqueShortName.c_str(),
+				Request.Prefix.c_str(),
+				hash,
+				Request.TechniqueId,
+				Request.TechniqueName.c_str());
+
+			State.Csv.write(csvLine, length);
+		}
+	}
+
+	void WriteCheckpoint(WriterState& State)
+	{
+		// Persist the manifest and describe how this run differs from the previous one. Shaders are loaded per
+		// area, so a run rarely sees all of them. Entries not seen this run are carried over from the previous
+		// manifest and reported as unseen rather than removed.
+		auto manifest = State.CurrentManifest;
+		manifest.insert(State.PreviousManifest.begin(), State.PreviousManifest.end());
+
+		SaveManifest(Plugin::ShaderDumpBinPath / ManifestFileName, manifest);
+
+		std::ofstream report(Plugin::ShaderDumpBinPath / DeltaReportFileName, std::ios::trunc);
+		size_t addedCount = 0;
+		size_t changedCount = 0;
+		size_t unseenCount = 0;
+
+		const auto writeLine = [&](const char *Change, const ManifestKey& Key, uint64_t OldHash, uint64_t NewHash)
+		{
+			const auto& [techniqueShortName, prefix, techniqueId] = Key;
+
+			char line[1024];
+			auto length = sprintf_s(
+				line,
+				"%s,%s,%s,%llX,%016llX,%016llX\n",
+				Change,
+				techniqueShortName.c_str(),
+				prefix.c_str(),
+				techniqueId,
+				OldHash,
+				NewHash);
+
+			report.write(line, length);
+		};
+
+		report << "# Change,TechniqueShortName,Prefix,TechniqueId,OldContentHash,NewContentHash\n";
+
+		for (const auto& [key, entry] : State.CurrentManifest)
+		{
+			if (auto itr = State.PreviousManifest.find(key); itr == State.PreviousManifest.end())
+			{
+				writeLine("added", key, 0, entry.ContentHash);
+				addedCount++;
+			}
+			else if (itr->second.ContentHash != entry.ContentHash)
+			{
+				writeLine("changed", key, itr->second.ContentHash, entry.ContentHash);
+				changedCount++;
+			}
+		}
+
+		for (const auto& [key, entry] : State.PreviousManifest)
+		{
+			if (!State.CurrentManifest.contains(key))
+			{
+				writeLine("unseen", key, entry.ContentHash, entry.ContentHash);
+				unseenCount++;
+			}
+		}
+
+		spdlog::info(
+			"Shader dump: {} file(s) written, {} unchanged. Compared to the previous dump: {} added, {} changed, {} not seen this run.",
+			State.WrittenCount,
+			State.SkippedCount,
+			addedCount,
+			changedCount,
+			unseenCount);
+	}
+
+	void InitializeState()
+	{
+		static char csvBuffer[CsvBufferSize];
+		std::error_code ec;
+
+		// Failures surface as write errors further down. Nothing can be done about them here.
+		std::filesystem::create_directories(Plugin::ShaderDumpBinPath, ec);
+		Writer.PreviousManifest = LoadManifest(Plugin::ShaderDumpBinPath / ManifestFileName);
+
+		if (!Writer.PreviousManifest.empty())
+			spdlog::info("Shader dump: Loaded {} entries from the previous manifest.", Writer.PreviousManifest.size());
+
+		// The CSV stays open for the lifetime of the process. The buffer has to be set before the file is opened.
+		Writer.Csv.rdbuf()->pubsetbuf(csvBuffer, sizeof(csvBuffer));
+		Writer.Csv.open(Plugin::ShaderDumpBinPath / "ShaderTechniqueMap.csv", std::ios::app);
+	}
+
+	void ReleasePendingBytes(size_t Size)
+	{
+		if (Size == 0)
+			return;
+
+		PendingBytes -= Size;
+
+		// Every producer that was blocked at this point gets a chance to retry
+		if (const auto blocked = BlockedProducers.load(); blocked > 0)
+			ReleaseSemaphore(PendingBytesSemaphore, blocked, nullptr);
+	}
+
+	bool TryReservePendingBytes(size_t Size)
+	{
+		auto pending = PendingBytes.load();
+
+		// A request larger than the whole budget still goes through once the queue has drained
+		while (pending == 0 || pending + Size <= MaxPendingBytes)
+		{
+			if (PendingBytes.compare_exchange_weak(pending, pending + Size))
+				return true;
+		}
+
+		return false;
+	}
+
+	void ProcessPendingRequests()
+	{
+		// Grab everything queued so far in one go. The list comes back newest first.
+		const auto insertPosition = Backlog.size();
+
+		for (auto entry = InterlockedFlushSList(&PendingRequests); entry;)
+		{
+			auto request = reinterpret_cast<DumpRequest *>(entry);
+			entry = entry->Next;
+
+			Backlog.emplace(Backlog.begin() + insertPosition, request);
+		}
+
+		// Requests stay in the backlog until they're fully written
+		while (!Backlog.empty())
+		{
+			const auto& request = Backlog.front();
+
+			if (request->IsCheckpoint)
+				WriteCheckpoint(Writer);
+			else
+				WriteRequest(*request, Writer);
+
+			const auto size = request->Bytecode.size();
+			Backlog.pop_front();
+			ReleasePendingBytes(size);
+		}
+
+		// Don't leave CSV lines sitting in the buffer if the game exits or crashes
+		Writer.Csv.flush();
+	}
+
+	void WriterThread()
+	{
+		InitializeState();
+
+		while (true)
+		{
+			WaitForSingleObject(PendingRequestsEvent, INFINITE);
+			ProcessPendingRequests();
+		}
+	}
+
+	void Push(DumpRequest *Request)
+	{
+		static bool once = []()
+		{
+			InitializeSListHead(&PendingRequests);
+			PendingRequestsEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+			PendingBytesSemaphore = CreateSemaphoreW(nullptr, 0, std::numeric_limits<LONG>::max(), nullptr);
+
+			std::thread(WriterThread).detach();
+			return true;
+		}();
+
+		// Wait for the writer to catch up. Blocked producers are counted before retrying so a release can't be
+		// missed in between.
+		if (const auto size = Request->Bytecode.size(); size > 0 && !TryReservePendingBytes(size))
+		{
+			BlockedProducers++;
+
+			while (!TryReservePendingBytes(size))
+				WaitForSingleObject(PendingBytesSemaphore, INFINITE);
+
+			BlockedProducers--;
+		}
+
+		InterlockedPushEntrySList(&PendingRequests, &Request->Entry);
+		SetEvent(PendingRequestsEvent);
+	}
+
+	void Enqueue(
+		const char *TechniqueShortName,
+		const char *Prefix,
+		uint64_t TechniqueId,
+		const char *TechniqueName,
+		std::span<const uint8_t> Bytecode)
+	{
+		// The game is free to release its bytecode once the pipeline is created. Take a private copy.
+		Push(new DumpRequest {
+			.TechniqueShortName = TechniqueShortName,
+			.Prefix = Prefix,
+			.TechniqueId = TechniqueId,
+			.TechniqueName = TechniqueName,
+			.Bytecode = { Bytecode.begin(), Bytecode.end() },
+		});
+	}
+
+	void Checkpoint()
+	{
+		// Processed in order with the dump requests queued before it
+		Push(new DumpRequest { .IsCheckpoint = true });
+	}
+
+	void Materialize(const std::filesystem::path& DumpDirectory, const std::filesystem::path& OutputDirectory)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const auto manifestPath = DumpDirectory / ManifestFileName;
+
+		if (!std::filesystem::exists(manifestPath))
+		{
+			spdlog::error("Unable to materialize shader dump: {} doesn't exist.", manifestPath.string());
+			return;
+		}
+
+		std::unordered_set<std::string> createdDirectories;
+		size_t linkedCount = 0;
+		size_t copiedCount = 0;
+		size_t failedCount = 0;
+
+		for (const auto& [key, entry] : LoadManifest(manifestPath))
+		{
+			// Regular dumps already use the loose layout
+			if (entry.Blob.empty())
+				continue;
+
+			const auto blobPath = GetBlobPath(DumpDirectory, entry.Blob);
+			const auto shaderBinFullPath = GetShaderBinPath(OutputDirectory, key);
+			std::error_code ec;
+
+			if (createdDirectories.emplace(std::get<0>(key)).second)
+				std::filesystem::create_directories(shaderBinFullPath.parent_path(), ec);
+
+			// Hard links cost nothing but only work within a volume. Fall back to copying.
+			std::filesystem::remove(shaderBinFullPath, ec);
+			std::filesystem::create_hard_link(blobPath, shaderBinFullPath, ec);
+
+			if (!ec)
+			{
+				linkedCount++;
+			}
+			else if (std::filesystem::copy_file(blobPath, shaderBinFullPath, std::filesystem::copy_options::overwrite_existing, ec))
+			{
+				copiedCount++;
+			}
+			else
+			{
+				failedCount++;
+				spdlog::warn("Failed to materialize {}: {}", shaderBinFullPath.string(), ec.message());
+			}
+		}
+
+		const auto end = std::chrono::steady_clock::now();
+
+		spdlog::info(
+			"Materialized shader dump into {}: {} hard link(s), {} copies, {} failure(s) in {} ms.",
+			OutputDirectory.string(),
+			linkedCount,
+			copiedCount,
+			failedCount,
+			std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+	}
+}
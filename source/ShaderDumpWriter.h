@@ -0,0 +1,24 @@
+#pragma once
+
+namespace ShaderDumpWriter
+{
+	// Dumping happens on the game's pipeline creation threads. Requests are copied onto a lock-free queue and
+	// written out by a dedicated thread so those threads never wait on the disk. Callers only block when the
+	// queued copies exceed a fixed memory budget.
+	void Enqueue(
+		const char *TechniqueShortName,
+		const char *Prefix,
+		uint64_t TechniqueId,
+		const char *TechniqueName,
+		std::span<const uint8_t> Bytecode);
+
+	// Dumps are incremental. Shaders whose content hash matches the previous run's manifest aren't rewritten.
+	// A checkpoint is queued behind everything enqueued so far. Once the writer gets to it, the manifest is saved
+	// along with a report of added and changed shaders. Shaders that weren't loaded this run stay in the manifest.
+	// Nothing is written at process exit. Requests still queued by then are lost.
+	void Checkpoint();
+
+	// Deduplicated dumps store each unique blob once under Blobs\ along with a manifest. Materializing recreates
+	// the regular <TechniqueShortName>\<TechniqueShortName>_<TechniqueId>_<Prefix>.bin layout from them.
+	void Materialize(const std::filesystem::path& DumpDirectory, const std::filesystem::path& OutputDirectory);
+}
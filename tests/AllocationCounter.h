@@ -0,0 +1,47 @@
+#pragma once
+
+//
+// Replaces the global allocation functions so code can be measured by allocation count. Include from exactly one
+// file per test executable.
+//
+namespace AllocationCounter
+{
+	size_t Count = 0;
+	size_t Bytes = 0;
+}
+
+void *operator new(size_t Size)
+{
+	AllocationCounter::Count++;
+	AllocationCounter::Bytes += Size;
+
+	if (auto ptr = malloc(Size ? Size : 1))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t Size)
+{
+	return operator new(Size);
+}
+
+void operator delete(void *Pointer) noexcept
+{
+	free(Pointer);
+}
+
+void operator delete[](void *Pointer) noexcept
+{
+	free(Pointer);
+}
+
+void operator delete(void *Pointer, size_t) noexcept
+{
+	free(Pointer);
+}
+
+void operator delete[](void *Pointer, size_t) noexcept
+{
+	free(Pointer);
+}
@@ -0,0 +1,60 @@
+#include "PipelineCapture.h"
+#include "Plugin.h"
+#include "SyntheticStreams.h"
+
+//
+// Writes a small synthetic pipeline capture along with replacement shaders for some of its techniques. Gives
+// PipelineReplay something to run under ctest without a capture from the game.
+//
+// Usage: GeneratePipelineCapture <capture file> <game directory>
+//
+// Every fourth of the RequestCount techniques gets a replacement pixel shader in <game directory>\Data\shadersfx.
+//
+constexpr uint32_t RequestCount = 16;
+constexpr uint32_t ReplacedInterval = 4;
+
+int main(int argc, char **argv)
+{
+	if (argc != 3)
+	{
+		spdlog::error("Usage: {} <capture file> <game directory>", argv[0]);
+		return 2;
+	}
+
+	const std::filesystem::path capturePath(argv[1]);
+	const auto shaderDirectory = std::filesystem::path(argv[2]) / "Data" / "shadersfx";
+
+	std::filesystem::create_directories(capturePath.parent_path());
+	std::filesystem::create_directories(shaderDirectory);
+	Plugin::PipelineCapturePath = capturePath;
+
+	for (uint32_t i = 0; i < RequestCount; i++)
+	{
+		const auto shortName = fmt::format("GeneratedTech{}", i);
+		const auto name = shortName + "-Default";
+		const uint64_t techniqueId = 0x10000 + i;
+
+		const auto stream = SyntheticStreams::MakeGraphicsStream(i);
+		const auto desc = stream.GetDesc();
+
+		PipelineCapture::Record(
+			techniqueId,
+			name.c_str(),
+			D3DPipelineStateStream::Copy(&desc).Serialize(),
+			{},
+			std::chrono::microseconds(100));
+
+		if (i % ReplacedInterval != 0)
+			continue;
+
+		const auto replacementPath = shaderDirectory / shortName / fmt::format("{}_{:X}_ps.bin", shortName, techniqueId);
+		const auto replacement = SyntheticStreams::MakeShader(1000 + i, 4096);
+
+		std::filesystem::create_directories(replacementPath.parent_path());
+		std::ofstream(replacementPath, std::ios::binary | std::ios::trunc)
+			.write(reinterpret_cast<const char *>(replacement.data()), replacement.size());
+	}
+
+	PipelineCapture::Flush();
+	return 0;
+}
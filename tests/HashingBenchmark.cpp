@@ -0,0 +1,138 @@
+#include "Hashing.h"
+#include "TestUtil.h"
+
+namespace HashingBenchmark
+{
+	// Compiled DXIL ranges from a few hundred bytes for trivial vertex shaders to ~100 KB for large compute shaders
+	constexpr std::array BlobSizes = { 256uz, 4096uz, 32768uz, 131072uz };
+
+	// Enough data per size that timings aren't dominated by the clock
+	constexpr size_t BytesPerSize = 256 * 1024 * 1024;
+
+	// What content hashes used before XXH3. Kept here as the baseline.
+	uint64_t FNV1A64(const void *Input, size_t Length)
+	{
+		constexpr uint64_t FNV1_PRIME_64 = 0x00000100000001B3;
+		constexpr uint64_t FNV1_BASE_64 = 14695981039346656037ULL;
+
+		auto data = reinterpret_cast<const unsigned char *>(Input);
+		auto end = data + Length;
+
+		auto hash = FNV1_BASE_64;
+
+		for (; data != end; data++)
+		{
+			hash ^= *data;
+			hash *= FNV1_PRIME_64;
+		}
+
+		return hash;
+	}
+
+	std::vector<uint8_t> MakeBlob(size_t Size, uint32_t Seed)
+	{
+		std::vector<uint8_t> data(Size);
+		uint32_t state = Seed | 1;
+
+		for (auto& value : data)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			value = static_cast<uint8_t>(state);
+		}
+
+		return data;
+	}
+
+	void CheckProperties()
+	{
+		const auto blob = MakeBlob(4096, 1);
+
+		// Stored in archives and dump manifests, so it must not change between runs or builds
+		CHECK(Hashing::ComputeContentHash(blob) == Hashing::ComputeContentHash(blob));
+		CHECK(Hashing::ComputeContentHash(blob) == Hashing::ComputeContentHash(blob, 0));
+		CHECK(Hashing::FNV1A32("ColorGradingMerge", 17) == Hashing::FNV1A32("ColorGradingMerge", 17));
+		CHECK(Hashing::FNV1A32("", 0) == 2166136261U);
+
+		// Seeds give the independent hash used for dump collision checks
+		CHECK(Hashing::ComputeContentHash(blob, 1) != Hashing::ComputeContentHash(blob, 0));
+		CHECK(Hashing::ComputeContentHash(blob, 1) != Hashing::ComputeContentHash(blob, 2));
+
+		// Any single flipped bit changes the hash
+		auto modified = blob;
+
+		for (size_t i = 0; i < modified.size(); i += 97)
+		{
+			modified[i] ^= 0x10;
+			CHECK(Hashing::ComputeContentHash(modified) != Hashing::ComputeContentHash(blob));
+			modified[i] ^= 0x10;
+		}
+
+		// Trailing data isn't ignored
+		CHECK(Hashing::ComputeContentHash(std::span(blob).first(4095)) != Hashing::ComputeContentHash(blob));
+		CHECK(Hashing::ComputeContentHash({}) != Hashing::ComputeContentHash(std::span(blob).first(1)));
+	}
+
+	void Run()
+	{
+		CheckProperties();
+
+		for (const auto size : BlobSizes)
+		{
+			// Several distinct blobs so the inputs don't all sit in L1
+			std::vector<std::vector<uint8_t>> blobs;
+
+			for (uint32_t i = 0; i < 16; i++)
+				blobs.emplace_back(MakeBlob(size, i + 1));
+
+			const size_t iterations = BytesPerSize / size;
+			uint64_t sink = 0;
+
+			const auto xxh3Time = TestUtil::MeasureNanoseconds(
+				iterations,
+				[&](size_t i)
+				{
+					sink += Hashing::ComputeContentHash(blobs[i % blobs.size()]);
+				});
+
+			const auto fnv64Time = TestUtil::MeasureNanoseconds(
+				iterations,
+				[&](size_t i)
+				{
+					const auto& blob = blobs[i % blobs.size()];
+					sink += FNV1A64(blob.data(), blob.size());
+				});
+
+			const auto fnv32Time = TestUtil::MeasureNanoseconds(
+				iterations,
+				[&](size_t i)
+				{
+					const auto& blob = blobs[i % blobs.size()];
+					sink += Hashing::FNV1A32(blob.data(), blob.size());
+				});
+
+			// Keeps the hashing from being optimized out
+			CHECK(sink != 0);
+
+			const auto toGBps = [&](double Nanoseconds)
+			{
+				return size / std::max(Nanoseconds, 1.0);
+			};
+
+			spdlog::info(
+				"{:>6} byte blobs: XXH3 {:.2f} GB/s, FNV-1a 64 {:.2f} GB/s ({:.1f}x), FNV-1a 32 {:.2f} GB/s.",
+				size,
+				toGBps(xxh3Time),
+				toGBps(fnv64Time),
+				fnv64Time / std::max(xxh3Time, 1.0),
+				toGBps(fnv32Time));
+		}
+	}
+}
+
+int main()
+{
+	HashingBenchmark::Run();
+	return TestUtil::Finish();
+}
@@ -0,0 +1,86 @@
+#include <algorithm>
+#include "D3DPipelineStateStream.h"
+#include "Hashing.h"
+#include "SyntheticStreams.h"
+#include "TestUtil.h"
+
+namespace PipelineFingerprintBenchmark
+{
+	// A full load of the game plus live update rescans
+	constexpr uint32_t StreamCount = 10000;
+	constexpr size_t Passes = 5;
+
+	void Run()
+	{
+		std::vector<SyntheticStreams::Stream> streams;
+		std::vector<D3D12_PIPELINE_STATE_STREAM_DESC> descs;
+		size_t shaderBytes = 0;
+
+		for (uint32_t i = 0; i < StreamCount; i++)
+		{
+			descs.emplace_back(streams.emplace_back(SyntheticStreams::MakeGameLikeStream(i)).GetDesc());
+
+			D3DPipelineStateStream::ForEachSubobject(
+				&descs.back(),
+				[&](auto Type, const auto& Payload)
+				{
+					if constexpr (D3DPipelineStateStream::IsShaderSubobjectType(Type))
+						shaderBytes += Payload.BytecodeLength;
+				});
+		}
+
+		// Every synthetic stream is different, so any repeat is a collision
+		std::vector<D3DPipelineStateStream::Fingerprint> fingerprints(StreamCount);
+
+		const auto fingerprintTime = TestUtil::MeasureNanoseconds(
+			StreamCount * Passes,
+			[&](size_t i)
+			{
+				const auto index = i % StreamCount;
+				const auto fingerprint = D3DPipelineStateStream::ComputeFingerprint(&descs[index]);
+
+				fingerprints[index] = fingerprint.value_or(D3DPipelineStateStream::Fingerprint {});
+			});
+
+		std::ranges::sort(fingerprints, {}, [](const auto& F) { return std::make_pair(F.High, F.Low); });
+		CHECK(std::ranges::adjacent_find(fingerprints) == fingerprints.end());
+		CHECK(fingerprints.front() != D3DPipelineStateStream::Fingerprint {});
+
+		// Lower bound: hashing only the shader bytes without walking anything else
+		uint64_t sink = 0;
+
+		const auto shaderHashTime = TestUtil::MeasureNanoseconds(
+			StreamCount * Passes,
+			[&](size_t i)
+			{
+				D3DPipelineStateStream::ForEachSubobject(
+					&descs[i % StreamCount],
+					[&](auto Type, const auto& Payload)
+					{
+						if constexpr (D3DPipelineStateStream::IsShaderSubobjectType(Type))
+						{
+							const auto bytecode = static_cast<const uint8_t *>(Payload.pShaderBytecode);
+							sink += Hashing::ComputeContentHash({ bytecode, Payload.BytecodeLength });
+						}
+					});
+			});
+
+		CHECK(sink != 0);
+
+		spdlog::info(
+			"Fingerprinted {} synthetic streams ({:.1f} MB of shaders) {} times: {:.0f} ns per stream, {:.2f} GB/s. Hashing "
+			"the shaders alone: {:.0f} ns per stream.",
+			StreamCount,
+			shaderBytes / (1024.0 * 1024.0),
+			Passes,
+			fingerprintTime,
+			(shaderBytes / static_cast<double>(StreamCount)) / std::max(fingerprintTime, 1.0),
+			shaderHashTime);
+	}
+}
+
+int main()
+{
+	PipelineFingerprintBenchmark::Run();
+	return TestUtil::Finish();
+}
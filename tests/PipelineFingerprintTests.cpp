@@ -0,0 +1,239 @@
+#include <algorithm>
+#include "AllocationCounter.h"
+#include "D3DPipelineStateStream.h"
+#include "SyntheticStreams.h"
+#include "TestUtil.h"
+
+namespace PipelineFingerprintTests
+{
+	using D3DPipelineStateStream::ComputeFingerprint;
+	using SyntheticStreams::Stream;
+
+	std::optional<D3DPipelineStateStream::Fingerprint> Fingerprint(const Stream& Stream, std::span<const uint8_t> RootSignatureData = {})
+	{
+		const auto desc = Stream.GetDesc();
+		return ComputeFingerprint(&desc, RootSignatureData);
+	}
+
+	void CheckPointerIndependence()
+	{
+		// Built twice, so every shader, input layout and semantic name lives at a different address
+		for (uint32_t seed = 0; seed < 50; seed++)
+		{
+			const auto first = SyntheticStreams::MakeEveryTypeStream(seed);
+			const auto second = SyntheticStreams::MakeEveryTypeStream(seed);
+
+			CHECK(Fingerprint(first).has_value());
+			CHECK(Fingerprint(first) == Fingerprint(second));
+			CHECK(Fingerprint(first) != Fingerprint(SyntheticStreams::MakeEveryTypeStream(seed + 1)));
+
+			// Retained copies point to their own memory and still match once the source is gone
+			std::optional<D3DPipelineStateStream::Copy> copy;
+			{
+				const auto source = SyntheticStreams::MakeEveryTypeStream(seed);
+				const auto desc = source.GetDesc();
+
+				copy.emplace(&desc);
+				copy->Retain();
+			}
+
+			CHECK(ComputeFingerprint(copy->GetDesc()) == Fingerprint(first));
+		}
+	}
+
+	void CheckContentSensitivity()
+	{
+		const auto baseline = SyntheticStreams::MakeEveryTypeStream(1);
+		const auto expected = Fingerprint(baseline);
+
+		const auto checkChanged = [&](const char *Description, auto&& Modify)
+		{
+			auto stream = SyntheticStreams::MakeEveryTypeStream(1);
+			Modify(stream);
+
+			if (Fingerprint(stream) == expected)
+			{
+				spdlog::error("Fingerprint didn't change: {}", Description);
+				CHECK(false);
+			}
+		};
+
+		checkChanged(
+			"last shader byte",
+			[](Stream& Stream)
+			{
+				auto& ps = SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS>(Stream);
+				const_cast<uint8_t *>(static_cast<const uint8_t *>(ps.pShaderBytecode))[ps.BytecodeLength - 1] ^= 1;
+			});
+
+		checkChanged(
+			"shader length",
+			[](Stream& Stream)
+			{
+				SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS>(Stream).BytecodeLength--;
+			});
+
+		checkChanged(
+			"semantic name contents",
+			[](Stream& Stream)
+			{
+				auto& layout = SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT>(Stream);
+				const_cast<char *>(layout.pInputElementDescs[1].SemanticName)[0] = 'X';
+			});
+
+		checkChanged(
+			"input element format",
+			[](Stream& Stream)
+			{
+				auto& layout = SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT>(Stream);
+				const_cast<D3D12_INPUT_ELEMENT_DESC *>(layout.pInputElementDescs)[0].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+			});
+
+		checkChanged(
+			"stream output stride",
+			[](Stream& Stream)
+			{
+				auto& so = SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT>(Stream);
+				const_cast<UINT *>(so.pBufferStrides)[2]++;
+			});
+
+		checkChanged(
+			"stream output semantic",
+			[](Stream& Stream)
+			{
+				auto& so = SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT>(Stream);
+				const_cast<D3D12_SO_DECLARATION_ENTRY *>(so.pSODeclaration)[1].SemanticName = so.pSODeclaration[0].SemanticName;
+			});
+
+		checkChanged(
+			"view instance location",
+			[](Stream& Stream)
+			{
+				auto& viewInstancing = SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VIEW_INSTANCING>(Stream);
+				const_cast<D3D12_VIEW_INSTANCE_LOCATION *>(viewInstancing.pViewInstanceLocations)[1].ViewportArrayIndex = 7;
+			});
+
+		checkChanged(
+			"blend write mask",
+			[](Stream& Stream)
+			{
+				SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_BLEND>(Stream).RenderTarget[7].RenderTargetWriteMask = 0;
+			});
+
+		checkChanged(
+			"rasterizer",
+			[](Stream& Stream)
+			{
+				SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RASTERIZER>(Stream).SlopeScaledDepthBias = 1.5f;
+			});
+
+		checkChanged(
+			"depth bounds",
+			[](Stream& Stream)
+			{
+				auto& depthStencil = SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL1>(Stream);
+				depthStencil.DepthBoundsTestEnable = !depthStencil.DepthBoundsTestEnable;
+			});
+
+		checkChanged(
+			"active render target format",
+			[](Stream& Stream)
+			{
+				auto& formats = SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RENDER_TARGET_FORMATS>(Stream);
+				formats.RTFormats[0] = DXGI_FORMAT_UNKNOWN;
+			});
+
+		checkChanged(
+			"subobject type",
+			[](Stream& Stream)
+			{
+				// Same payload layout, different stage. Subobjects start pointer aligned.
+				const auto bytes = Stream.GetBytes();
+				const auto& vs = SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS>(Stream);
+				const auto payloadOffset = static_cast<size_t>(reinterpret_cast<const uint8_t *>(&vs) - bytes.data());
+				const auto typeOffset = (payloadOffset - sizeof(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE)) & ~(alignof(void *) - 1);
+				const auto type = D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS;
+
+				memcpy(bytes.data() + typeOffset, &type, sizeof(type));
+			});
+
+		// Root signatures are opaque objects and have to be described by their serialized blob
+		const uint8_t rootSignatureA[] = { 1, 2, 3, 4 };
+		const uint8_t rootSignatureB[] = { 1, 2, 3, 5 };
+
+		CHECK(Fingerprint(baseline, rootSignatureA) != expected);
+		CHECK(Fingerprint(baseline, rootSignatureA) != Fingerprint(baseline, rootSignatureB));
+		CHECK(Fingerprint(baseline, rootSignatureA) == Fingerprint(SyntheticStreams::MakeEveryTypeStream(1), rootSignatureA));
+	}
+
+	void CheckIgnoredData()
+	{
+		const auto expected = Fingerprint(SyntheticStreams::MakeEveryTypeStream(2));
+
+		// Cached blobs are derived data
+		const std::vector<uint8_t> cachedBlob(4096, 0xCC);
+		CHECK(Fingerprint(SyntheticStreams::MakeEveryTypeStream(2, cachedBlob.data(), cachedBlob.size())) == expected);
+
+		// Formats past NumRenderTargets are ignored by the runtime
+		auto stream = SyntheticStreams::MakeEveryTypeStream(2);
+		auto& formats = SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RENDER_TARGET_FORMATS>(stream);
+		formats.RTFormats[7] = DXGI_FORMAT_R32G32_FLOAT;
+		CHECK(formats.NumRenderTargets < 8 && Fingerprint(stream) == expected);
+
+		// Padding after RenderTargetWriteMask and between subobjects
+		auto& blend = SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_BLEND>(stream);
+
+		for (auto& target : blend.RenderTarget)
+		{
+			const auto padding = reinterpret_cast<uint8_t *>(&target.RenderTargetWriteMask) + 1;
+			const auto end = reinterpret_cast<uint8_t *>(&target + 1);
+
+			std::fill(padding, end, static_cast<uint8_t>(0xCD));
+		}
+
+		const auto bytes = stream.GetBytes();
+		const auto typeEnd = bytes.data() + sizeof(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE);
+		auto& rootSignature = SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE>(stream);
+
+		std::fill(typeEnd, reinterpret_cast<uint8_t *>(&rootSignature), static_cast<uint8_t>(0xCD));
+
+		CHECK(Fingerprint(stream) == expected);
+	}
+
+	void CheckUnknownTypes()
+	{
+		auto stream = SyntheticStreams::MakeGraphicsStream(3);
+		const auto bytes = stream.GetBytes();
+		const auto type = static_cast<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE>(D3DPipelineStateStream::SubobjectTypeLimit - 1);
+
+		CHECK(!D3DPipelineStateStream::IsKnownSubobjectType(type));
+		memcpy(bytes.data(), &type, sizeof(type));
+
+		CHECK(!Fingerprint(stream));
+	}
+
+	void CheckNoAllocations()
+	{
+		const auto stream = SyntheticStreams::MakeEveryTypeStream(4);
+		const auto before = AllocationCounter::Count;
+
+		const auto fingerprint = Fingerprint(stream);
+
+		CHECK(fingerprint && AllocationCounter::Count == before);
+	}
+
+	void Run()
+	{
+		CheckPointerIndependence();
+		CheckContentSensitivity();
+		CheckIgnoredData();
+		CheckUnknownTypes();
+		CheckNoAllocations();
+	}
+}
+
+int main()
+{
+	PipelineFingerprintTests::Run();
+	return TestUtil::Finish();
+}
@@ -0,0 +1,58 @@
+#include <charconv>
+#include "D3DShaderReplacement.h"
+#include "PipelineCapture.h"
+#include "StubDevice.h"
+
+//
+// Replays a pipeline capture against StubDevice to measure the plugin's own overhead without the game or a GPU.
+//
+// Usage: PipelineReplay <capture file> [game directory] [simulated compile time in microseconds]
+//
+// Replacement shaders are read from <game directory>\Data\shadersfx, which defaults to the working directory.
+//
+int main(int argc, char **argv)
+{
+	if (argc < 2 || argc > 4)
+	{
+		spdlog::error("Usage: {} <capture file> [game directory] [simulated compile time in microseconds]", argv[0]);
+		return 2;
+	}
+
+	const auto capturePath = std::filesystem::absolute(argv[1]);
+	StubDevice::Options options;
+
+	if (argc >= 3)
+		std::filesystem::current_path(argv[2]);
+
+	if (argc >= 4)
+	{
+		const std::string_view latency(argv[3]);
+		uint32_t microseconds = 0;
+
+		if (const auto result = std::from_chars(latency.data(), latency.data() + latency.size(), microseconds);
+			result.ec != std::errc() || result.ptr != latency.data() + latency.size())
+		{
+			spdlog::error("Invalid compile time: {}", latency);
+			return 2;
+		}
+
+		options.CreatePipelineStateLatency = std::chrono::microseconds(microseconds);
+	}
+
+	D3DShaderReplacement::RefreshReplacementSources();
+
+	const auto device = StubDevice::Create(options);
+
+	if (!PipelineCapture::Replay(capturePath, device.Get()))
+		return 1;
+
+	const auto statistics = StubDevice::GetStatistics(device.Get());
+
+	spdlog::info(
+		"Stub device: {} pipeline(s) and {} root signature(s) created, {} invalid argument(s).",
+		statistics.CreatePipelineStateCount,
+		statistics.CreateRootSignatureCount,
+		statistics.InvalidArgumentCount);
+
+	return 0;
+}
@@ -0,0 +1,220 @@
+#include <set>
+#include "D3DPipelineStateStream.h"
+#include "SyntheticStreams.h"
+#include "TestUtil.h"
+
+namespace PipelineSerializationTests
+{
+	using D3DPipelineStateStream::Copy;
+	using D3DPipelineStateStream::SerializedStreamHeader;
+
+	std::vector<uint8_t> Serialize(const SyntheticStreams::Stream& Stream, bool Retain)
+	{
+		const auto desc = Stream.GetDesc();
+		Copy copy(&desc);
+
+		if (Retain)
+			copy.Retain();
+
+		return copy.Serialize();
+	}
+
+	// Byte offset of a subobject's payload field within serialized data
+	template<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type>
+	size_t GetSerializedPayloadOffset(const SyntheticStreams::Stream& Stream, std::span<const uint8_t> Data, size_t FieldOffset = 0)
+	{
+		const auto desc = Stream.GetDesc();
+		const auto start = static_cast<const uint8_t *>(desc.pPipelineStateSubobjectStream);
+		size_t payloadOffset = 0;
+
+		D3DPipelineStateStream::ForEachSubobject(
+			&desc,
+			[&](auto SubobjectType, const auto& Payload)
+			{
+				if constexpr (SubobjectType == Type)
+					payloadOffset = reinterpret_cast<const uint8_t *>(&Payload) - start;
+			});
+
+		SerializedStreamHeader header;
+		memcpy(&header, Data.data(), sizeof(header));
+
+		return header.StreamOffset + payloadOffset + FieldOffset;
+	}
+
+	void CheckStringsEqual(const char *A, const char *B)
+	{
+		CHECK((A == nullptr) == (B == nullptr));
+		CHECK(!A || !B || strcmp(A, B) == 0);
+	}
+
+	void CheckRoundTrip(bool Retain)
+	{
+		const std::vector<uint8_t> cachedBlob(1000, 0x5A);
+		const auto source = SyntheticStreams::MakeEveryTypeStream(11, cachedBlob.data(), cachedBlob.size());
+		const auto sourceDesc = source.GetDesc();
+
+		auto data = Serialize(source, Retain);
+
+		SerializedStreamHeader header;
+		memcpy(&header, data.data(), sizeof(header));
+
+		CHECK(header.Magic == D3DPipelineStateStream::SerializedStreamMagic);
+		CHECK(header.Version == D3DPipelineStateStream::SerializedStreamVersion);
+		CHECK(header.TotalSize == data.size());
+		CHECK(header.StreamSize == sourceDesc.SizeInBytes);
+
+		// Relocatable: the source stream's memory is gone and the data moved before it's read back
+		std::vector<uint8_t> moved(data.size() + 3);
+		memcpy(moved.data() + 3, data.data(), data.size());
+		data.clear();
+
+		const auto copy = Copy::Deserialize(std::span(moved).subspan(3));
+		CHECK(copy);
+
+		if (!copy)
+			return;
+
+		CHECK(D3DPipelineStateStream::ComputeFingerprint(copy->GetDesc()) == D3DPipelineStateStream::ComputeFingerprint(&sourceDesc));
+		CHECK(copy->Serialize() == std::vector(moved.begin() + 3, moved.end()));
+
+		// Every known type survives and everything points into the copy
+		std::set<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE> foundTypes;
+
+		const bool walkedWholeStream = D3DPipelineStateStream::ForEachSubobject(
+			copy->GetDesc(),
+			[&](auto Type, const auto& Payload)
+			{
+				foundTypes.emplace(Type);
+
+				D3DPipelineStateStream::ForEachReferencedBuffer(
+					Type,
+					Payload,
+					[&](const auto& Pointer, size_t)
+					{
+						CHECK(!Pointer || copy->IsOwned(Pointer));
+					});
+
+				if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE)
+				{
+					CHECK(Payload == nullptr);
+				}
+				else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO)
+				{
+					// Retaining drops cached blobs
+					if (Retain)
+						CHECK(!Payload.pCachedBlob && Payload.CachedBlobSizeInBytes == 0);
+					else
+						CHECK(std::equal(cachedBlob.begin(), cachedBlob.end(), static_cast<const uint8_t *>(Payload.pCachedBlob)));
+				}
+				else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT)
+				{
+					const auto& sourceLayout = SyntheticStreams::GetPayload<Type>(source);
+
+					for (UINT i = 0; i < Payload.NumElements; i++)
+					{
+						CHECK(copy->IsOwned(Payload.pInputElementDescs[i].SemanticName));
+						CheckStringsEqual(Payload.pInputElementDescs[i].SemanticName, sourceLayout.pInputElementDescs[i].SemanticName);
+					}
+				}
+				else if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT)
+				{
+					const auto& sourceOutput = SyntheticStreams::GetPayload<Type>(source);
+
+					for (UINT i = 0; i < Payload.NumEntries; i++)
+						CheckStringsEqual(Payload.pSODeclaration[i].SemanticName, sourceOutput.pSODeclaration[i].SemanticName);
+				}
+			});
+
+		CHECK(walkedWholeStream);
+
+		for (size_t type = 0; type < D3DPipelineStateStream::SubobjectTypeLimit; type++)
+		{
+			const auto subobjectType = static_cast<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE>(type);
+			CHECK(foundTypes.contains(subobjectType) == D3DPipelineStateStream::IsKnownSubobjectType(subobjectType));
+		}
+	}
+
+	void CheckGameLikeStreams()
+	{
+		for (uint32_t seed = 0; seed < 200; seed++)
+		{
+			const auto source = SyntheticStreams::MakeGameLikeStream(seed);
+			const auto sourceDesc = source.GetDesc();
+			const auto copy = Copy::Deserialize(Serialize(source, seed % 2));
+			CHECK(copy);
+
+			if (copy)
+			{
+				const auto fingerprint = D3DPipelineStateStream::ComputeFingerprint(copy->GetDesc());
+				CHECK(fingerprint && fingerprint == D3DPipelineStateStream::ComputeFingerprint(&sourceDesc));
+			}
+		}
+
+		// Empty streams are valid
+		const SyntheticStreams::Stream empty;
+		const auto copy = Copy::Deserialize(Serialize(empty, true));
+
+		CHECK(copy && copy->GetDesc()->SizeInBytes == 0);
+	}
+
+	void CheckMalformed()
+	{
+		const auto source = SyntheticStreams::MakeEveryTypeStream(12);
+		const auto valid = Serialize(source, true);
+
+		CHECK(Copy::Deserialize(valid));
+		CHECK(!Copy::Deserialize({}));
+		CHECK(!Copy::Deserialize(std::span(valid).first(valid.size() - 1)));
+
+		const auto patch = [&](size_t Offset, auto Value)
+		{
+			auto data = valid;
+			memcpy(data.data() + Offset, &Value, sizeof(Value));
+
+			return data;
+		};
+
+		CHECK(!Copy::Deserialize(patch(offsetof(SerializedStreamHeader, Magic), uint32_t(0))));
+		CHECK(!Copy::Deserialize(patch(offsetof(SerializedStreamHeader, Version), uint32_t(0))));
+		CHECK(!Copy::Deserialize(patch(offsetof(SerializedStreamHeader, TotalSize), uint64_t(valid.size() + 1))));
+		CHECK(!Copy::Deserialize(patch(offsetof(SerializedStreamHeader, StreamOffset), uint64_t(8))));
+		CHECK(!Copy::Deserialize(patch(offsetof(SerializedStreamHeader, StreamSize), uint64_t(valid.size()))));
+
+		// Referenced data has to stay inside the buffer and can't point back into the header
+		const auto psOffset = GetSerializedPayloadOffset<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS>(source, valid);
+
+		CHECK(!Copy::Deserialize(patch(psOffset, uint64_t(valid.size()))));
+		CHECK(!Copy::Deserialize(patch(psOffset, uint64_t(8))));
+		CHECK(!Copy::Deserialize(patch(psOffset + offsetof(D3D12_SHADER_BYTECODE, BytecodeLength), uint64_t(valid.size()))));
+
+		// Semantic names must be terminated within the buffer
+		const auto layoutOffset = GetSerializedPayloadOffset<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT>(source, valid);
+		uint64_t elementsOffset = 0;
+		memcpy(&elementsOffset, valid.data() + layoutOffset, sizeof(elementsOffset));
+
+		auto unterminated = patch(elementsOffset + offsetof(D3D12_INPUT_ELEMENT_DESC, SemanticName), uint64_t(valid.size() - 1));
+		unterminated.back() = 'A';
+
+		CHECK(!Copy::Deserialize(unterminated));
+
+		// Unknown subobject types can't be walked
+		const auto firstTypeOffset = GetSerializedPayloadOffset<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE>(source, valid) -
+			alignof(void *);
+
+		CHECK(!Copy::Deserialize(patch(firstTypeOffset, static_cast<uint32_t>(D3DPipelineStateStream::SubobjectTypeLimit - 1))));
+	}
+
+	void Run()
+	{
+		CheckRoundTrip(false);
+		CheckRoundTrip(true);
+		CheckGameLikeStreams();
+		CheckMalformed();
+	}
+}
+
+int main()
+{
+	PipelineSerializationTests::Run();
+	return TestUtil::Finish();
+}
@@ -0,0 +1,177 @@
+#include "AllocationCounter.h"
+#include "D3DPipelineStateStream.h"
+#include "SyntheticStreams.h"
+#include "TestUtil.h"
+
+namespace PipelineStreamCopyBenchmark
+{
+	// Roughly the number of pipelines the game creates while loading
+	constexpr uint32_t StreamCount = 7000;
+
+	//
+	// How Copy worked before it had an arena: the stream and every buffer it points to are separate allocations
+	//
+	class PerPointerCopy
+	{
+	private:
+		std::vector<std::unique_ptr<uint8_t[]>> m_TempBuffers;
+		D3D12_PIPELINE_STATE_STREAM_DESC m_CopiedDesc = {};
+
+	public:
+		PerPointerCopy(const D3D12_PIPELINE_STATE_STREAM_DESC *Description)
+		{
+			m_CopiedDesc.pPipelineStateSubobjectStream = memdup(Description->pPipelineStateSubobjectStream, Description->SizeInBytes);
+			m_CopiedDesc.SizeInBytes = Description->SizeInBytes;
+
+			D3DPipelineStateStream::ForEachSubobject(
+				&m_CopiedDesc,
+				[&](auto Type, auto& Payload)
+				{
+					D3DPipelineStateStream::ForEachReferencedBuffer(
+						Type,
+						Payload,
+						[&](auto& Pointer, size_t Size)
+						{
+							Pointer = memdup(Pointer, Size);
+						});
+				});
+		}
+
+	private:
+		template<typename T>
+		T *memdup(const T *Data, size_t Size)
+		{
+			if (!Data)
+				return nullptr;
+
+			auto& ptr = m_TempBuffers.emplace_back(std::make_unique<uint8_t[]>(Size));
+			return reinterpret_cast<T *>(memcpy(ptr.get(), Data, Size));
+		}
+	};
+
+	struct Measurement
+	{
+		size_t Allocations = 0;
+		size_t Bytes = 0;
+		double Nanoseconds = 0;
+	};
+
+	template<typename T>
+	Measurement Measure(const std::vector<SyntheticStreams::Stream>& Streams, T&& Callback)
+	{
+		const auto startCount = AllocationCounter::Count;
+		const auto startBytes = AllocationCounter::Bytes;
+
+		const auto time = TestUtil::MeasureNanoseconds(
+			Streams.size(),
+			[&](size_t i)
+			{
+				const auto desc = Streams[i].GetDesc();
+				Callback(&desc);
+			});
+
+		return {
+			.Allocations = AllocationCounter::Count - startCount,
+			.Bytes = AllocationCounter::Bytes - startBytes,
+			.Nanoseconds = time,
+		};
+	}
+
+	void CheckRetainedCopies(const std::vector<SyntheticStreams::Stream>& Streams)
+	{
+		for (uint32_t i = 0; i < Streams.size(); i += 97)
+		{
+			const auto desc = Streams[i].GetDesc();
+			D3DPipelineStateStream::Copy copy(&desc);
+
+			// The lazy copy only duplicates the subobject stream
+			CHECK(copy.GetArenaSize() >= desc.SizeInBytes && copy.GetArenaSize() < desc.SizeInBytes + alignof(std::max_align_t));
+			CHECK(copy.IsOwned(copy.GetDesc()->pPipelineStateSubobjectStream));
+
+			const auto before = AllocationCounter::Count;
+			copy.Retain();
+			CHECK(AllocationCounter::Count - before == 1);
+
+			// Everything now lives in the arena and survives the source stream's buffers
+			size_t referencedBytes = 0;
+
+			D3DPipelineStateStream::ForEachSubobject(
+				copy.GetDesc(),
+				[&](auto Type, auto& Payload)
+				{
+					D3DPipelineStateStream::ForEachReferencedBuffer(
+						Type,
+						Payload,
+						[&](auto& Pointer, size_t Size)
+						{
+							if (!Pointer)
+								return;
+
+							CHECK(copy.IsOwned(Pointer));
+							CHECK(reinterpret_cast<uintptr_t>(Pointer) % alignof(std::max_align_t) == 0);
+							referencedBytes += Size;
+						});
+				});
+
+			CHECK(copy.GetArenaSize() >= desc.SizeInBytes + referencedBytes);
+			CHECK(D3DPipelineStateStream::ComputeFingerprint(copy.GetDesc()) == D3DPipelineStateStream::ComputeFingerprint(&desc));
+		}
+	}
+
+	void Run()
+	{
+		std::vector<SyntheticStreams::Stream> streams;
+
+		for (uint32_t i = 0; i < StreamCount; i++)
+			streams.emplace_back(SyntheticStreams::MakeGameLikeStream(i));
+
+		CheckRetainedCopies(streams);
+
+		const auto perPointer = Measure(
+			streams,
+			[](const D3D12_PIPELINE_STATE_STREAM_DESC *Desc)
+			{
+				PerPointerCopy copy(Desc);
+			});
+
+		const auto lazy = Measure(
+			streams,
+			[](const D3D12_PIPELINE_STATE_STREAM_DESC *Desc)
+			{
+				D3DPipelineStateStream::Copy copy(Desc);
+			});
+
+		const auto retained = Measure(
+			streams,
+			[](const D3D12_PIPELINE_STATE_STREAM_DESC *Desc)
+			{
+				D3DPipelineStateStream::Copy copy(Desc);
+				copy.Retain();
+			});
+
+		CHECK(lazy.Allocations == StreamCount);
+		CHECK(retained.Allocations == StreamCount * 2);
+		CHECK(perPointer.Allocations > retained.Allocations);
+
+		const auto log = [&](const char *Name, const Measurement& Result)
+		{
+			spdlog::info(
+				"{:<24} {:>6.2f} allocations, {:>7.0f} bytes, {:>6.0f} ns per stream",
+				Name,
+				static_cast<double>(Result.Allocations) / StreamCount,
+				static_cast<double>(Result.Bytes) / StreamCount,
+				Result.Nanoseconds);
+		};
+
+		spdlog::info("Copying {} synthetic pipeline streams:", StreamCount);
+		log("Per pointer (old)", perPointer);
+		log("Arena, lazy", lazy);
+		log("Arena, retained", retained);
+	}
+}
+
+int main()
+{
+	PipelineStreamCopyBenchmark::Run();
+	return TestUtil::Finish();
+}
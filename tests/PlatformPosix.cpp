@@ -0,0 +1,89 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Platform.h"
+
+//
+// POSIX counterpart of source/PlatformWin32.cpp so the plugin modules can run under tests outside of Windows
+//
+namespace Platform
+{
+	std::error_code GetLastErrorCode()
+	{
+		return std::error_code(errno, std::system_category());
+	}
+
+	std::span<const uint8_t> LoadFile(
+		const std::filesystem::path& Path,
+		bool PrivateCopy,
+		std::shared_ptr<const void>& Owner,
+		std::error_code& Error)
+	{
+		const int fd = open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+
+		if (fd == -1)
+		{
+			Error = GetLastErrorCode();
+			return {};
+		}
+
+		std::span<const uint8_t> data;
+		struct stat fileStat = {};
+
+		// Zero-length files can't be mapped
+		if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0 && fileStat.st_size <= std::numeric_limits<uint32_t>::max())
+		{
+			const auto size = static_cast<size_t>(fileStat.st_size);
+
+			if (PrivateCopy)
+			{
+				std::shared_ptr<uint8_t[]> heapData(new uint8_t[size]);
+				size_t bytesRead = 0;
+
+				for (ssize_t n; bytesRead < size && (n = read(fd, heapData.get() + bytesRead, size - bytesRead)) > 0;)
+					bytesRead += static_cast<size_t>(n);
+
+				if (bytesRead == size)
+				{
+					data = { heapData.get(), size };
+					Owner = std::move(heapData);
+				}
+			}
+			else
+			{
+				if (const auto view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0); view != MAP_FAILED)
+				{
+					data = { static_cast<const uint8_t *>(view), size };
+					Owner = std::shared_ptr<const void>(
+						view,
+						[size](const void *View)
+						{
+							munmap(const_cast<void *>(View), size);
+						});
+				}
+			}
+		}
+
+		Error = data.empty() ? GetLastErrorCode() : std::error_code();
+		close(fd);
+
+		return data;
+	}
+
+	void PrefetchMemory(std::span<const uint8_t> Data)
+	{
+		// madvise() wants page aligned ranges
+		const auto pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+		const auto begin = reinterpret_cast<uintptr_t>(Data.data()) & ~(pageSize - 1);
+		const auto end = reinterpret_cast<uintptr_t>(Data.data() + Data.size());
+
+		madvise(reinterpret_cast<void *>(begin), end - begin, MADV_WILLNEED);
+	}
+
+	std::error_code WatchDirectory(const std::filesystem::path& Directory, const std::function<void()>& Callback)
+	{
+		// Live updates are a developer tool for the game. Tests trigger refreshes explicitly.
+		return std::make_error_code(std::errc::function_not_supported);
+	}
+}
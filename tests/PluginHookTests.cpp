@@ -0,0 +1,301 @@
+#include "CRHooks.h"
+#include "D3DHooks.h"
+#include "D3DShaderReplacement.h"
+#include "PipelineCapture.h"
+#include "Plugin.h"
+#include "StubDevice.h"
+#include "SyntheticStreams.h"
+#include "TestUtil.h"
+
+namespace PluginHookTests
+{
+	using CreationRenderer::ShaderInputsContainerDx12;
+	using CreationRenderer::TechniqueData;
+
+	//
+	// Stand-in for the game's technique structures. Only the fields read by the hooks are filled in.
+	//
+	class FakeTechnique
+	{
+	private:
+		alignas(TechniqueData) uint8_t m_TechniqueStorage[sizeof(TechniqueData)] = {};
+		alignas(ShaderInputsContainerDx12) uint8_t m_InputsStorage[sizeof(ShaderInputsContainerDx12)] = {};
+
+	public:
+		FakeTechnique(const char *Name, uint64_t Id)
+		{
+			auto tech = Get();
+			tech->m_Inputs = reinterpret_cast<ShaderInputsContainerDx12 *>(m_InputsStorage);
+			tech->m_Inputs->m_RootSignatureBlob = nullptr;
+			tech->m_Inputs->m_RootSignatureBlobSize = 0;
+			tech->m_Id = Id;
+			tech->m_Name = Name;
+			tech->m_PipelineState = nullptr;
+		}
+
+		FakeTechnique(const FakeTechnique&) = delete;
+		FakeTechnique& operator=(const FakeTechnique&) = delete;
+
+		TechniqueData *Get()
+		{
+			return reinterpret_cast<TechniqueData *>(m_TechniqueStorage);
+		}
+	};
+
+	constexpr uint64_t PatchedTechniqueId = 0x1A2B3C;
+	constexpr uint64_t VanillaTechniqueId = 0x4D5E6F;
+
+	void WriteReplacement(const std::filesystem::path& Path, const std::vector<uint8_t>& Data)
+	{
+		std::filesystem::create_directories(Path.parent_path());
+
+		std::ofstream f(Path, std::ios::binary | std::ios::trunc);
+		f.write(reinterpret_cast<const char *>(Data.data()), Data.size());
+	}
+
+	std::optional<D3DPipelineStateStream::Fingerprint> Fingerprint(const SyntheticStreams::Stream& Stream)
+	{
+		const auto desc = Stream.GetDesc();
+		return D3DPipelineStateStream::ComputeFingerprint(&desc);
+	}
+
+	// Vanilla stream with its pixel shader swapped for Replacement
+	std::optional<D3DPipelineStateStream::Fingerprint> GetPatchedFingerprint(uint32_t Seed, const std::vector<uint8_t>& Replacement)
+	{
+		auto stream = SyntheticStreams::MakeGraphicsStream(Seed);
+		SyntheticStreams::GetPayload<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS>(stream) = { Replacement.data(), Replacement.size() };
+
+		return Fingerprint(stream);
+	}
+
+	HRESULT CreatePipeline(ID3D12Device2 *Device, FakeTechnique& Technique, uint32_t Seed)
+	{
+		// The game's stream goes away as soon as the call returns
+		const auto stream = SyntheticStreams::MakeGraphicsStream(Seed);
+		const auto desc = stream.GetDesc();
+
+		return D3DHooks::CreatePipelineStateForTechnique(
+			Device,
+			&desc,
+			IID_ID3D12PipelineState,
+			reinterpret_cast<void **>(&Technique.Get()->m_PipelineState),
+			Technique.Get());
+	}
+
+	void CheckLiveUpdates(ID3D12Device2 *Device)
+	{
+		// Replacements are looked up in <working directory>\Data\shadersfx
+		const auto& shaderDirectory = D3DShaderReplacement::GetShaderBinDirectory();
+		const auto replacementPath = shaderDirectory / "PatchedTech" / fmt::format("PatchedTech_{:X}_ps.bin", PatchedTechniqueId);
+		const auto firstReplacement = SyntheticStreams::MakeShader(1000, 4096);
+		const auto secondReplacement = SyntheticStreams::MakeShader(1001, 4096);
+
+		WriteReplacement(replacementPath, firstReplacement);
+		D3DShaderReplacement::RefreshReplacementSources();
+
+		FakeTechnique patched("PatchedTech-Default", PatchedTechniqueId);
+		FakeTechnique vanilla("VanillaTech-Default", VanillaTechniqueId);
+
+		CHECK(SUCCEEDED(CreatePipeline(Device, patched, 1)));
+		CHECK(SUCCEEDED(CreatePipeline(Device, vanilla, 2)));
+
+		const auto patchedPipeline = patched.Get()->m_PipelineState;
+		const auto vanillaPipeline = vanilla.Get()->m_PipelineState;
+
+		CHECK(patchedPipeline && vanillaPipeline);
+		CHECK(StubDevice::GetPipelineFingerprint(patchedPipeline) == GetPatchedFingerprint(1, firstReplacement));
+		CHECK(StubDevice::GetPipelineFingerprint(vanillaPipeline) == Fingerprint(SyntheticStreams::MakeGraphicsStream(2)));
+
+		// Nothing changed on disk
+		D3DShaderReplacement::RefreshReplacementSources();
+		CHECK(CRHooks::RefreshTrackedPipelines(Device) == 0);
+		CHECK(patched.Get()->m_PipelineState == patchedPipeline);
+
+		// Edited replacements are swapped in. The tracked stream outlived the game's copy.
+		WriteReplacement(replacementPath, secondReplacement);
+		D3DShaderReplacement::RefreshReplacementSources();
+
+		CHECK(CRHooks::RefreshTrackedPipelines(Device) == 1);
+		CHECK(patched.Get()->m_PipelineState != patchedPipeline);
+		CHECK(vanilla.Get()->m_PipelineState == vanillaPipeline);
+		CHECK(StubDevice::GetPipelineFingerprint(patched.Get()->m_PipelineState) == GetPatchedFingerprint(1, secondReplacement));
+
+		// Up to date again
+		CHECK(CRHooks::RefreshTrackedPipelines(Device) == 0);
+
+		const auto statistics = StubDevice::GetStatistics(Device);
+		CHECK(statistics.CreatePipelineStateCount == 3);
+
+		// Pipeline library misses report E_INVALIDARG. Nothing else may.
+		CHECK(statistics.InvalidArgumentCount == statistics.LoadPipelineMissCount);
+	}
+
+	void CheckCapture(ID3D12Device2 *Device)
+	{
+		const auto capturePath = std::filesystem::current_path() / "Capture.bin";
+		Plugin::PipelineCapturePath = capturePath;
+
+		FakeTechnique patched("PatchedTech-Capture", PatchedTechniqueId);
+		FakeTechnique vanilla("VanillaTech-Capture", VanillaTechniqueId + 1);
+
+		CHECK(SUCCEEDED(CreatePipeline(Device, patched, 3)));
+		CHECK(SUCCEEDED(CreatePipeline(Device, vanilla, 4)));
+
+		// Records are buffered until the next idle flush
+		PipelineCapture::Flush();
+		Plugin::PipelineCapturePath.clear();
+
+		std::vector<uint8_t> capture(std::filesystem::file_size(capturePath));
+		std::ifstream(capturePath, std::ios::binary).read(reinterpret_cast<char *>(capture.data()), capture.size());
+
+		// Both requests are created again, the patched one with its replacement
+		const auto before = StubDevice::GetStatistics(Device);
+		CHECK(PipelineCapture::Replay(capturePath, Device));
+		const auto after = StubDevice::GetStatistics(Device);
+
+		CHECK(after.CreatePipelineStateCount - before.CreatePipelineStateCount == 2);
+		CHECK(after.InvalidArgumentCount == before.InvalidArgumentCount);
+
+		// Damaged captures are rejected before anything is allocated for them
+		const auto replayModified = [&](std::vector<uint8_t> Data)
+		{
+			const auto path = std::filesystem::current_path() / "Modified.bin";
+			std::ofstream(path, std::ios::binary | std::ios::trunc).write(reinterpret_cast<const char *>(Data.data()), Data.size());
+
+			return PipelineCapture::Replay(path, Device);
+		};
+
+		// CaptureFileHeader, then the first record's CaptureRecordHeader::StreamSize
+		constexpr size_t firstStreamSizeOffset = 0x8 + 0x18;
+		auto oversized = capture;
+		const uint64_t streamSize = 1ull << 60;
+		memcpy(oversized.data() + firstStreamSizeOffset, &streamSize, sizeof(streamSize));
+
+		CHECK(!replayModified(oversized));
+		CHECK(!replayModified({ capture.begin(), capture.end() - 1 }));
+		CHECK(!replayModified({ capture.begin(), capture.begin() + 4 }));
+	}
+
+	void CheckBackgroundCoalescing(ID3D12Device2 *Device)
+	{
+		// Slow enough that any request waiting on the compile stands out
+		constexpr auto compileLatency = std::chrono::milliseconds(200);
+		constexpr uint64_t coalescedTechniqueId = 0x7A8B9C;
+		constexpr uint32_t seed = 5;
+
+		const auto slowDevice = StubDevice::Create({ .CreatePipelineStateLatency = compileLatency });
+		const auto& shaderDirectory = D3DShaderReplacement::GetShaderBinDirectory();
+		const auto replacementPath = shaderDirectory / "CoalescedTech" / fmt::format("CoalescedTech_{:X}_ps.bin", coalescedTechniqueId);
+		const auto replacement = SyntheticStreams::MakeShader(1002, 4096);
+
+		WriteReplacement(replacementPath, replacement);
+		D3DShaderReplacement::RefreshReplacementSources();
+
+		// The vanilla stand-ins come from the game's library so neither request has to compile anything itself
+		const auto vanillaStream = SyntheticStreams::MakeGraphicsStream(seed);
+		const auto vanillaDesc = vanillaStream.GetDesc();
+
+		CComPtr<ID3D12PipelineLibrary1> gameLibrary;
+		CComPtr<ID3D12PipelineState> vanillaPipeline;
+
+		CHECK(SUCCEEDED(slowDevice->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&gameLibrary))));
+		CHECK(SUCCEEDED(Device->CreatePipelineState(&vanillaDesc, IID_PPV_ARGS(&vanillaPipeline))));
+		CHECK(SUCCEEDED(gameLibrary->StorePipeline(L"CoalescedTech", vanillaPipeline.Get())));
+
+		Plugin::AsyncPatchedPipelines = true;
+
+		// Two game threads ask for the same technique at the same time
+		FakeTechnique first("CoalescedTech-Default", coalescedTechniqueId);
+		FakeTechnique second("CoalescedTech-Default", coalescedTechniqueId);
+
+		const auto request = [&](FakeTechnique& Technique)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			const auto stream = SyntheticStreams::MakeGraphicsStream(seed);
+			const auto desc = stream.GetDesc();
+
+			D3DHooks::LoadPipelineForTechnique(
+				gameLibrary.Get(),
+				L"CoalescedTech",
+				&desc,
+				IID_ID3D12PipelineState,
+				reinterpret_cast<void **>(&Technique.Get()->m_PipelineState),
+				Technique.Get());
+
+			const auto hr = D3DHooks::CreatePipelineStateForTechnique(
+				slowDevice.Get(),
+				&desc,
+				IID_ID3D12PipelineState,
+				reinterpret_cast<void **>(&Technique.Get()->m_PipelineState),
+				Technique.Get());
+
+			return std::make_pair(hr, std::chrono::steady_clock::now() - start);
+		};
+
+		auto firstRequest = std::async(std::launch::async, request, std::ref(first));
+		auto secondRequest = std::async(std::launch::async, request, std::ref(second));
+
+		// Neither one waits for the compile, including the one that found it already pending
+		for (const auto& [hr, time] : { firstRequest.get(), secondRequest.get() })
+		{
+			CHECK(SUCCEEDED(hr));
+			CHECK(time < compileLatency / 2);
+		}
+
+		// Both are switched over to the single patched pipeline once the worker is done
+		const auto expected = GetPatchedFingerprint(seed, replacement);
+		const auto isPatched = [&](FakeTechnique& Technique)
+		{
+			const auto pipeline = std::atomic_ref(Technique.Get()->m_PipelineState).load();
+			return StubDevice::GetPipelineFingerprint(pipeline) == expected;
+		};
+
+		const auto deadline = std::chrono::steady_clock::now() + compileLatency * 20;
+
+		while ((!isPatched(first) || !isPatched(second)) && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+		CHECK(isPatched(first));
+		CHECK(isPatched(second));
+
+		const auto statistics = StubDevice::GetStatistics(slowDevice.Get());
+		CHECK(statistics.LoadPipelineHitCount == 2);
+		CHECK(statistics.CreatePipelineStateCount == 1);
+
+		Plugin::AsyncPatchedPipelines = false;
+	}
+
+	void Run()
+	{
+		// Devices are tracked once. Starting without live updates keeps the filesystem watcher thread from
+		// racing with the explicit refreshes.
+		const auto device = StubDevice::Create();
+		CRHooks::TrackDevice(device);
+
+		Plugin::AllowLiveUpdates = true;
+
+		CheckLiveUpdates(device.Get());
+		CheckCapture(device.Get());
+		CheckBackgroundCoalescing(device.Get());
+	}
+}
+
+int main()
+{
+	int result;
+	{
+		const TestUtil::TemporaryDirectory directory("PluginHookTests");
+		const auto previousDirectory = std::filesystem::current_path();
+
+		std::filesystem::current_path(directory.GetPath());
+		PluginHookTests::Run();
+		std::filesystem::current_path(previousDirectory);
+
+		result = TestUtil::Finish();
+	}
+
+	// The plugin's worker threads are detached and never stop, same as in the game. Static destructors would tear
+	// down the state they're still waiting on.
+	spdlog::shutdown();
+	std::quick_exit(result);
+}
@@ -0,0 +1,55 @@
+#include "DebuggingUtil.h"
+#include "Plugin.h"
+#include "ReShadeHelper.h"
+#include "ShaderDumpWriter.h"
+
+//
+// Stand-ins for the plugin modules that need the game, ReShade or Win32 threading. Settings keep their defaults
+// until a test changes them. Nothing here is ever enabled by the tests.
+//
+namespace Plugin
+{
+	bool AllowLiveUpdates = false;
+	bool InsertDebugMarkers = false;
+	bool AsyncPatchedPipelines = false;
+	bool WarmupPatchedPipelines = false;
+	std::filesystem::path ShaderDumpBinPath;
+	bool DeduplicateShaderDump = false;
+	std::filesystem::path ShaderDumpMaterializePath;
+	std::filesystem::path ShaderArchivePackPath;
+	std::filesystem::path PipelineCapturePath;
+}
+
+namespace DebuggingUtil
+{
+	void SetObjectDebugName(ID3D12Object *Object, const char *Name)
+	{
+	}
+}
+
+namespace ReShadeHelper
+{
+	void Initialize()
+	{
+	}
+}
+
+namespace ShaderDumpWriter
+{
+	void Enqueue(
+		const char *TechniqueShortName,
+		const char *Prefix,
+		uint64_t TechniqueId,
+		const char *TechniqueName,
+		std::span<const uint8_t> Bytecode)
+	{
+	}
+
+	void Checkpoint()
+	{
+	}
+
+	void Materialize(const std::filesystem::path& DumpDirectory, const std::filesystem::path& OutputDirectory)
+	{
+	}
+}
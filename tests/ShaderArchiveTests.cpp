@@ -0,0 +1,177 @@
+#include "ShaderArchiveFormat.h"
+#include "TestUtil.h"
+
+namespace ShaderArchiveTests
+{
+	struct SourceBlob
+	{
+		uint64_t TechniqueId;
+		std::string_view Prefix;
+		std::vector<uint8_t> Data;
+	};
+
+	std::vector<uint8_t> MakeBlob(size_t Size, uint8_t Seed)
+	{
+		std::vector<uint8_t> data(Size);
+
+		for (size_t i = 0; i < Size; i++)
+			data[i] = static_cast<uint8_t>(Seed + (i * 31));
+
+		return data;
+	}
+
+	std::vector<uint8_t> ReadFile(const std::filesystem::path& Path)
+	{
+		std::ifstream f(Path, std::ios::binary);
+		return { std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>() };
+	}
+
+	void CheckRoundTrip(const std::filesystem::path& ArchivePath)
+	{
+		// Added out of order, with a duplicate key and with identical contents under different techniques
+		const std::vector<SourceBlob> sources = {
+			{ 0xFF81, "cs", MakeBlob(1000, 1) },
+			{ 0x12, "PS", MakeBlob(17, 2) },
+			{ 0x12, "vs", MakeBlob(4096, 3) },
+			{ 0xABCDEF0123, "ps", MakeBlob(17, 2) },
+			{ 0x12, "ps", MakeBlob(33, 4) }, // Replaces the earlier 0x12 "PS" since stages are case insensitive
+			{ 0x7, "hs", MakeBlob(1, 5) },
+		};
+
+		ShaderArchive::Writer writer;
+
+		for (const auto& source : sources)
+			writer.Add(source.TechniqueId, source.Prefix, source.Data);
+
+		CHECK(writer.GetEntryCount() == 5);
+		CHECK(writer.Save(ArchivePath));
+
+		const auto archiveData = ReadFile(ArchivePath);
+		ShaderArchive::Reader reader;
+
+		CHECK(reader.Open(archiveData));
+		CHECK(reader.GetEntries().size() == 5);
+
+		for (const auto& entry : reader.GetEntries())
+			CHECK(entry.Offset % ShaderArchive::BlobAlignment == 0 && entry.Reserved == 0);
+
+		const auto checkEntry = [&](uint64_t TechniqueId, std::string_view Prefix, const std::vector<uint8_t>& Expected)
+		{
+			const auto entry = reader.Find(TechniqueId, ShaderArchive::MakeStageTag(Prefix));
+			CHECK(entry);
+
+			if (!entry)
+				return;
+
+			const auto data = reader.GetData(*entry);
+			CHECK(std::ranges::equal(data, Expected));
+		};
+
+		checkEntry(0xFF81, "cs", sources[0].Data);
+		checkEntry(0x12, "vs", sources[2].Data);
+		checkEntry(0x12, "ps", sources[4].Data);
+		checkEntry(0xABCDEF0123, "ps", sources[3].Data);
+		checkEntry(0x7, "HS", sources[5].Data);
+
+		CHECK(!reader.Find(0x12, ShaderArchive::MakeStageTag("cs")));
+		CHECK(!reader.Find(0x13, ShaderArchive::MakeStageTag("ps")));
+
+		// 0x12 "PS" was overwritten. Only the 0xABCDEF0123 copy of its contents is left.
+		const auto unique = reader.Find(0xABCDEF0123, ShaderArchive::MakeStageTag("ps"));
+		const auto replaced = reader.Find(0x12, ShaderArchive::MakeStageTag("ps"));
+		CHECK(unique && replaced && unique->Offset != replaced->Offset);
+
+		// Identical contents are stored once
+		ShaderArchive::Writer dedupWriter;
+		dedupWriter.Add(1, "vs", MakeBlob(500, 9));
+		dedupWriter.Add(2, "vs", MakeBlob(500, 9));
+		dedupWriter.Add(3, "vs", MakeBlob(500, 10));
+		CHECK(dedupWriter.Save(ArchivePath));
+
+		const auto dedupData = ReadFile(ArchivePath);
+		CHECK(reader.Open(dedupData));
+
+		const auto first = reader.Find(1, ShaderArchive::MakeStageTag("vs"));
+		const auto second = reader.Find(2, ShaderArchive::MakeStageTag("vs"));
+		const auto third = reader.Find(3, ShaderArchive::MakeStageTag("vs"));
+
+		CHECK(first && second && third);
+		CHECK(first->Offset == second->Offset && first->ContentHash == second->ContentHash);
+		CHECK(first->Offset != third->Offset && first->ContentHash != third->ContentHash);
+	}
+
+	void CheckMalformed(const std::filesystem::path& ArchivePath)
+	{
+		ShaderArchive::Writer writer;
+		writer.Add(1, "vs", MakeBlob(64, 1));
+		writer.Add(2, "ps", MakeBlob(64, 2));
+		CHECK(writer.Save(ArchivePath));
+
+		const auto valid = ReadFile(ArchivePath);
+		ShaderArchive::Reader reader;
+		CHECK(reader.Open(valid));
+
+		const auto entries = [](std::vector<uint8_t>& Data)
+		{
+			return reinterpret_cast<ShaderArchive::ArchiveEntry *>(Data.data() + sizeof(ShaderArchive::ArchiveHeader));
+		};
+
+		const auto header = [](std::vector<uint8_t>& Data)
+		{
+			return reinterpret_cast<ShaderArchive::ArchiveHeader *>(Data.data());
+		};
+
+		CHECK(!reader.Open({}));
+		CHECK(!reader.Open(std::span(valid).first(sizeof(ShaderArchive::ArchiveHeader) - 1)));
+		CHECK(reader.GetEntries().empty());
+
+		auto data = valid;
+		header(data)->Magic++;
+		CHECK(!reader.Open(data));
+
+		data = valid;
+		header(data)->Version = ShaderArchive::ArchiveVersion + 1;
+		CHECK(!reader.Open(data));
+
+		data = valid;
+		header(data)->EntryCount = 0x10000;
+		CHECK(!reader.Open(data));
+
+		data = valid;
+		entries(data)[1].Offset = data.size() - 8;
+		CHECK(!reader.Open(data));
+
+		data = valid;
+		entries(data)[0].Size = ~0ull;
+		CHECK(!reader.Open(data));
+
+		// Binary searches rely on the sort order
+		data = valid;
+		std::swap(entries(data)[0], entries(data)[1]);
+		CHECK(!reader.Open(data));
+	}
+
+	void CheckStageTags()
+	{
+		CHECK(ShaderArchive::MakeStageTag("vs") == 0x7376);
+		CHECK(ShaderArchive::MakeStageTag("VS") == ShaderArchive::MakeStageTag("vs"));
+		CHECK(ShaderArchive::MakeStageTag("") == 0);
+		CHECK(ShaderArchive::MakeStageTag("abcdef") == ShaderArchive::MakeStageTag("abcd"));
+	}
+
+	void Run()
+	{
+		TestUtil::TemporaryDirectory directory("ShaderArchiveTests");
+		const auto archivePath = directory.GetPath() / "Test.ssa";
+
+		CheckStageTags();
+		CheckRoundTrip(archivePath);
+		CheckMalformed(archivePath);
+	}
+}
+
+int main()
+{
+	ShaderArchiveTests::Run();
+	return TestUtil::Finish();
+}
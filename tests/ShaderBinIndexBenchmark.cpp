@@ -0,0 +1,147 @@
+#include "ShaderBinIndex.h"
+#include "TestUtil.h"
+
+namespace ShaderBinIndexBenchmark
+{
+	// Roughly the size of a full shader dump: a few hundred technique directories with every stage overridden
+	constexpr size_t DirectoryCount = 500;
+	constexpr size_t FilesPerDirectory = 100;
+	constexpr std::array StagePrefixes = { "vs", "ps", "cs", "gs", "hs", "ds", "as", "ms" };
+
+	// ~7000 pipelines with up to 8 stages each are probed while the game loads
+	constexpr size_t ProbeCount = 7000 * StagePrefixes.size();
+
+	uint64_t MakeTechniqueId(size_t Directory, size_t File)
+	{
+		return 0x100000 + (Directory * FilesPerDirectory) + File;
+	}
+
+	std::string MakeShortName(size_t Directory)
+	{
+		// Underscores are legal in technique names and make parsing start from the end
+		return fmt::format("Synthetic_Technique{}", Directory);
+	}
+
+	void CreateTree(const std::filesystem::path& Root)
+	{
+		constexpr uint8_t contents[] = { 'D', 'X', 'B', 'C' };
+
+		for (size_t directory = 0; directory < DirectoryCount; directory++)
+		{
+			const auto shortName = MakeShortName(directory);
+			const auto directoryPath = Root / shortName;
+			std::filesystem::create_directories(directoryPath);
+
+			for (size_t file = 0; file < FilesPerDirectory; file++)
+			{
+				const auto fileName = fmt::format(
+					"{}_{:X}_{}.bin",
+					shortName,
+					MakeTechniqueId(directory, file),
+					StagePrefixes[file % StagePrefixes.size()]);
+
+				std::ofstream f(directoryPath / fileName, std::ios::binary);
+				f.write(reinterpret_cast<const char *>(contents), sizeof(contents));
+			}
+		}
+
+		// Noise the index has to skip
+		std::ofstream(Root / "readme.txt") << "Not a shader";
+		std::ofstream(Root / MakeShortName(0) / "NotAShader.txt") << "Not a shader";
+	}
+
+	void CheckParseFileName()
+	{
+		std::string_view shortName;
+		std::string_view prefix;
+		uint64_t techniqueId = 0;
+
+		CHECK(ShaderBinIndex::ParseFileName("ColorGradingMerge_FF81_cs.bin", shortName, techniqueId, prefix));
+		CHECK(shortName == "ColorGradingMerge" && techniqueId == 0xFF81 && prefix == "cs");
+
+		CHECK(ShaderBinIndex::ParseFileName("Some_Name_With_Underscores_1A_ps.BIN", shortName, techniqueId, prefix));
+		CHECK(shortName == "Some_Name_With_Underscores" && techniqueId == 0x1A && prefix == "ps");
+
+		CHECK(!ShaderBinIndex::ParseFileName("ColorGradingMerge_FF81_cs.txt", shortName, techniqueId, prefix));
+		CHECK(!ShaderBinIndex::ParseFileName("ColorGradingMerge_XYZ_cs.bin", shortName, techniqueId, prefix));
+		CHECK(!ShaderBinIndex::ParseFileName("FF81_cs.bin", shortName, techniqueId, prefix));
+		CHECK(!ShaderBinIndex::ParseFileName("ColorGradingMerge_FF81_.bin", shortName, techniqueId, prefix));
+	}
+
+	bool ProbeFile(const std::filesystem::path& Root, const char *ShortName, uint64_t TechniqueId, const char *Prefix)
+	{
+		// What every stage of every pipeline used to cost before the index: format a path and try to open it
+		char fileName[512];
+		snprintf(fileName, sizeof(fileName), "%s_%llX_%s.bin", ShortName, static_cast<unsigned long long>(TechniqueId), Prefix);
+
+		std::ifstream f(Root / ShortName / fileName, std::ios::binary | std::ios::ate);
+		return f.good();
+	}
+
+	void Run()
+	{
+		CheckParseFileName();
+
+		TestUtil::TemporaryDirectory root("ShaderBinIndexBenchmark");
+		CreateTree(root.GetPath());
+
+		const auto buildStart = std::chrono::steady_clock::now();
+		ShaderBinIndex::Build(root.GetPath());
+		const auto buildEnd = std::chrono::steady_clock::now();
+
+		CHECK(ShaderBinIndex::GetEntryCount() == DirectoryCount * FilesPerDirectory);
+
+		// Lookups are case insensitive like the filesystem they replace
+		const auto hit = ShaderBinIndex::Find("SYNTHETIC_TECHNIQUE7", MakeTechniqueId(7, 4), "HS");
+		CHECK(hit && hit->filename() == fmt::format("{}_{:X}_hs.bin", MakeShortName(7), MakeTechniqueId(7, 4)));
+		CHECK(!ShaderBinIndex::Find(MakeShortName(7).c_str(), MakeTechniqueId(7, 4), "ps"));
+		CHECK(!ShaderBinIndex::Find(MakeShortName(8).c_str(), MakeTechniqueId(7, 4), "hs"));
+
+		// Almost every probe misses in practice. Technique names are shared with the tree so directories exist.
+		std::vector<std::string> probeNames(ProbeCount);
+		std::vector<uint64_t> probeIds(ProbeCount);
+
+		for (size_t i = 0; i < ProbeCount; i++)
+		{
+			probeNames[i] = MakeShortName(i % DirectoryCount);
+			probeIds[i] = 0xF000000 + i;
+		}
+
+		size_t indexHits = 0;
+		size_t fileHits = 0;
+
+		const auto indexTime = TestUtil::MeasureNanoseconds(
+			ProbeCount,
+			[&](size_t i)
+			{
+				if (ShaderBinIndex::Find(probeNames[i].c_str(), probeIds[i], StagePrefixes[i % StagePrefixes.size()]))
+					indexHits++;
+			});
+
+		const auto fileTime = TestUtil::MeasureNanoseconds(
+			ProbeCount,
+			[&](size_t i)
+			{
+				if (ProbeFile(root.GetPath(), probeNames[i].c_str(), probeIds[i], StagePrefixes[i % StagePrefixes.size()]))
+					fileHits++;
+			});
+
+		CHECK(indexHits == 0 && fileHits == 0);
+
+		spdlog::info(
+			"Indexed {} files in {:.1f} ms. {} missed probes: {:.0f} ns each through the index, {:.0f} ns each through the "
+			"filesystem ({:.0f}x).",
+			ShaderBinIndex::GetEntryCount(),
+			std::chrono::duration<double, std::milli>(buildEnd - buildStart).count(),
+			ProbeCount,
+			indexTime,
+			fileTime,
+			fileTime / std::max(indexTime, 1.0));
+	}
+}
+
+int main()
+{
+	ShaderBinIndexBenchmark::Run();
+	return TestUtil::Finish();
+}
@@ -0,0 +1,768 @@
+#include "StubDevice.h"
+
+namespace StubDevice
+{
+	//
+	// Private class IDs. QueryInterface() with one of these is how objects passed back in by the caller are
+	// recognized as our own. Anything else is treated as foreign and rejected.
+	//
+	constexpr GUID DeviceClassId = { 0x5b3c1f4a, 0x8d2e, 0x4f61, { 0x9a, 0x07, 0x3e, 0x52, 0xc1, 0x8b, 0x64, 0xd0 } };
+	constexpr GUID RootSignatureClassId = { 0x5b3c1f4b, 0x8d2e, 0x4f61, { 0x9a, 0x07, 0x3e, 0x52, 0xc1, 0x8b, 0x64, 0xd0 } };
+	constexpr GUID PipelineStateClassId = { 0x5b3c1f4c, 0x8d2e, 0x4f61, { 0x9a, 0x07, 0x3e, 0x52, 0xc1, 0x8b, 0x64, 0xd0 } };
+	constexpr GUID PipelineLibraryClassId = { 0x5b3c1f4d, 0x8d2e, 0x4f61, { 0x9a, 0x07, 0x3e, 0x52, 0xc1, 0x8b, 0x64, 0xd0 } };
+
+	//
+	// [LibraryHeader]
+	// [LibraryEntry][Name]	Repeated EntryCount times. Names are UTF-16 without a terminator.
+	//
+	constexpr uint32_t LibraryMagic = 0x4C504453; // "SDPL"
+	constexpr uint32_t LibraryVersion = 1;
+
+	struct LibraryHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t EntryCount;
+	};
+	static_assert(sizeof(LibraryHeader) == 0x10);
+
+	struct LibraryEntry
+	{
+		D3DPipelineStateStream::Fingerprint Fingerprint;
+		uint64_t NameLength;
+	};
+	static_assert(sizeof(LibraryEntry) == 0x18);
+
+	//
+	// Reference counting and QueryInterface for a single inheritance chain of interfaces. BaseInterfaces has to
+	// list the rest of the chain down to IUnknown.
+	//
+	template<typename Self, const GUID& ClassId, typename Interface, typename... BaseInterfaces>
+	class ComObject : public Interface
+	{
+	private:
+		std::atomic_uint32_t m_RefCount = 1;
+		std::wstring m_Name;
+
+	public:
+		virtual ~ComObject() = default;
+
+		HRESULT QueryInterface(REFIID Riid, void **Object) override
+		{
+			if (!Object)
+				return E_POINTER;
+
+			*Object = nullptr;
+
+			// DirectX-Headers' __uuidof() takes expressions, not type names
+			if (Riid == ClassId)
+				*Object = static_cast<Self *>(this);
+			else if (Riid == __uuidof(static_cast<Interface *>(nullptr)) ||
+					 ((Riid == __uuidof(static_cast<BaseInterfaces *>(nullptr))) || ...))
+				*Object = static_cast<Interface *>(this);
+			else
+				return E_NOINTERFACE;
+
+			AddRef();
+			return S_OK;
+		}
+
+		ULONG AddRef() override
+		{
+			return ++m_RefCount;
+		}
+
+		ULONG Release() override
+		{
+			const auto count = --m_RefCount;
+
+			if (count == 0)
+				delete this;
+
+			return count;
+		}
+
+		HRESULT GetPrivateData(REFGUID Guid, UINT *DataSize, void *Data) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT SetPrivateData(REFGUID Guid, UINT DataSize, const void *Data) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT SetPrivateDataInterface(REFGUID Guid, const IUnknown *Data) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT SetName(LPCWSTR Name) override
+		{
+			m_Name = Name ? Name : L"";
+			return S_OK;
+		}
+
+		// Borrowed pointer to Object if it's one of ours, nullptr otherwise
+		static Self *FromInterface(IUnknown *Object)
+		{
+			Self *result = nullptr;
+
+			if (Object && SUCCEEDED(Object->QueryInterface(ClassId, reinterpret_cast<void **>(&result))))
+				result->Release();
+
+			return result;
+		}
+	};
+
+	class RootSignature;
+	class PipelineState;
+	class PipelineLibrary;
+
+	class Device : public ComObject<Device, DeviceClassId, ID3D12Device2, ID3D12Device1, ID3D12Device, ID3D12Object, IUnknown>
+	{
+	private:
+		const Options m_Options;
+		std::mutex m_StatisticsLock;
+		Statistics m_Statistics;
+
+	public:
+		Device(const Options& Options) : m_Options(Options)
+		{
+		}
+
+		Statistics GetStatistics()
+		{
+			std::scoped_lock lock(m_StatisticsLock);
+			return m_Statistics;
+		}
+
+		HRESULT Count(size_t Statistics::*Counter, HRESULT Hr = S_OK)
+		{
+			std::scoped_lock lock(m_StatisticsLock);
+			(m_Statistics.*Counter)++;
+
+			if (Hr == E_INVALIDARG)
+				m_Statistics.InvalidArgumentCount++;
+
+			return Hr;
+		}
+
+		HRESULT CountInvalidArgument()
+		{
+			std::scoped_lock lock(m_StatisticsLock);
+			m_Statistics.InvalidArgumentCount++;
+
+			return E_INVALIDARG;
+		}
+
+		static void SimulateLatency(std::chrono::microseconds Latency)
+		{
+			if (Latency.count() > 0)
+				std::this_thread::sleep_for(Latency);
+		}
+
+		const Options& GetOptions() const
+		{
+			return m_Options;
+		}
+
+		// Applies the same checks for CreatePipelineState and LoadPipeline. Root signatures have to come from this
+		// device since their blobs are part of the fingerprint.
+		std::optional<D3DPipelineStateStream::Fingerprint> ValidateStream(const D3D12_PIPELINE_STATE_STREAM_DESC *Desc);
+
+		HRESULT CreatePipelineState(const D3D12_PIPELINE_STATE_STREAM_DESC *Desc, REFIID Riid, void **PipelineState) override;
+
+		HRESULT CreateRootSignature(UINT NodeMask, const void *BlobWithRootSignature, SIZE_T BlobLengthInBytes, REFIID Riid, void **RootSignature)
+			override;
+
+		HRESULT CreatePipelineLibrary(const void *LibraryBlob, SIZE_T BlobLength, REFIID Riid, void **PipelineLibrary) override;
+
+		//
+		// Nothing else is needed to create pipelines
+		//
+		UINT GetNodeCount() override
+		{
+			return 1;
+		}
+
+		HRESULT CreateCommandQueue(const D3D12_COMMAND_QUEUE_DESC *Desc, REFIID Riid, void **CommandQueue) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE Type, REFIID Riid, void **CommandAllocator) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC *Desc, REFIID Riid, void **PipelineState) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC *Desc, REFIID Riid, void **PipelineState) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT CreateCommandList(
+			UINT NodeMask,
+			D3D12_COMMAND_LIST_TYPE Type,
+			ID3D12CommandAllocator *CommandAllocator,
+			ID3D12PipelineState *InitialState,
+			REFIID Riid,
+			void **CommandList) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT CheckFeatureSupport(D3D12_FEATURE Feature, void *FeatureSupportData, UINT FeatureSupportDataSize) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT CreateDescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC *DescriptorHeapDesc, REFIID Riid, void **Heap) override
+		{
+			return E_NOTIMPL;
+		}
+
+		UINT GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE DescriptorHeapType) override
+		{
+			return 0;
+		}
+
+		void CreateConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC *Desc, D3D12_CPU_DESCRIPTOR_HANDLE DestDescriptor) override
+		{
+		}
+
+		void CreateShaderResourceView(
+			ID3D12Resource *Resource,
+			const D3D12_SHADER_RESOURCE_VIEW_DESC *Desc,
+			D3D12_CPU_DESCRIPTOR_HANDLE DestDescriptor) override
+		{
+		}
+
+		void CreateUnorderedAccessView(
+			ID3D12Resource *Resource,
+			ID3D12Resource *CounterResource,
+			const D3D12_UNORDERED_ACCESS_VIEW_DESC *Desc,
+			D3D12_CPU_DESCRIPTOR_HANDLE DestDescriptor) override
+		{
+		}
+
+		void CreateRenderTargetView(
+			ID3D12Resource *Resource,
+			const D3D12_RENDER_TARGET_VIEW_DESC *Desc,
+			D3D12_CPU_DESCRIPTOR_HANDLE DestDescriptor) override
+		{
+		}
+
+		void CreateDepthStencilView(
+			ID3D12Resource *Resource,
+			const D3D12_DEPTH_STENCIL_VIEW_DESC *Desc,
+			D3D12_CPU_DESCRIPTOR_HANDLE DestDescriptor) override
+		{
+		}
+
+		void CreateSampler(const D3D12_SAMPLER_DESC *Desc, D3D12_CPU_DESCRIPTOR_HANDLE DestDescriptor) override
+		{
+		}
+
+		void CopyDescriptors(
+			UINT NumDestDescriptorRanges,
+			const D3D12_CPU_DESCRIPTOR_HANDLE *DestDescriptorRangeStarts,
+			const UINT *DestDescriptorRangeSizes,
+			UINT NumSrcDescriptorRanges,
+			const D3D12_CPU_DESCRIPTOR_HANDLE *SrcDescriptorRangeStarts,
+			const UINT *SrcDescriptorRangeSizes,
+			D3D12_DESCRIPTOR_HEAP_TYPE DescriptorHeapsType) override
+		{
+		}
+
+		void CopyDescriptorsSimple(
+			UINT NumDescriptors,
+			D3D12_CPU_DESCRIPTOR_HANDLE DestDescriptorRangeStart,
+			D3D12_CPU_DESCRIPTOR_HANDLE SrcDescriptorRangeStart,
+			D3D12_DESCRIPTOR_HEAP_TYPE DescriptorHeapsType) override
+		{
+		}
+
+		D3D12_RESOURCE_ALLOCATION_INFO GetResourceAllocationInfo(UINT VisibleMask, UINT NumResourceDescs, const D3D12_RESOURCE_DESC *ResourceDescs)
+			override
+		{
+			return {};
+		}
+
+		D3D12_HEAP_PROPERTIES GetCustomHeapProperties(UINT NodeMask, D3D12_HEAP_TYPE HeapType) override
+		{
+			return {};
+		}
+
+		HRESULT CreateCommittedResource(
+			const D3D12_HEAP_PROPERTIES *HeapProperties,
+			D3D12_HEAP_FLAGS HeapFlags,
+			const D3D12_RESOURCE_DESC *Desc,
+			D3D12_RESOURCE_STATES InitialResourceState,
+			const D3D12_CLEAR_VALUE *OptimizedClearValue,
+			REFIID RiidResource,
+			void **Resource) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT CreateHeap(const D3D12_HEAP_DESC *Desc, REFIID Riid, void **Heap) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT CreatePlacedResource(
+			ID3D12Heap *Heap,
+			UINT64 HeapOffset,
+			const D3D12_RESOURCE_DESC *Desc,
+			D3D12_RESOURCE_STATES InitialState,
+			const D3D12_CLEAR_VALUE *OptimizedClearValue,
+			REFIID Riid,
+			void **Resource) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT CreateReservedResource(
+			const D3D12_RESOURCE_DESC *Desc,
+			D3D12_RESOURCE_STATES InitialState,
+			const D3D12_CLEAR_VALUE *OptimizedClearValue,
+			REFIID Riid,
+			void **Resource) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT CreateSharedHandle(
+			ID3D12DeviceChild *Object,
+			const SECURITY_ATTRIBUTES *Attributes,
+			DWORD Access,
+			LPCWSTR Name,
+			HANDLE *Handle) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT OpenSharedHandle(HANDLE NTHandle, REFIID Riid, void **Obj) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT OpenSharedHandleByName(LPCWSTR Name, DWORD Access, HANDLE *NTHandle) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT MakeResident(UINT NumObjects, ID3D12Pageable *const *Objects) override
+		{
+			return S_OK;
+		}
+
+		HRESULT Evict(UINT NumObjects, ID3D12Pageable *const *Objects) override
+		{
+			return S_OK;
+		}
+
+		HRESULT CreateFence(UINT64 InitialValue, D3D12_FENCE_FLAGS Flags, REFIID Riid, void **Fence) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT GetDeviceRemovedReason() override
+		{
+			return S_OK;
+		}
+
+		void GetCopyableFootprints(
+			const D3D12_RESOURCE_DESC *ResourceDesc,
+			UINT FirstSubresource,
+			UINT NumSubresources,
+			UINT64 BaseOffset,
+			D3D12_PLACED_SUBRESOURCE_FOOTPRINT *Layouts,
+			UINT *NumRows,
+			UINT64 *RowSizeInBytes,
+			UINT64 *TotalBytes) override
+		{
+		}
+
+		HRESULT CreateQueryHeap(const D3D12_QUERY_HEAP_DESC *Desc, REFIID Riid, void **Heap) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT SetStablePowerState(BOOL Enable) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT CreateCommandSignature(
+			const D3D12_COMMAND_SIGNATURE_DESC *Desc,
+			ID3D12RootSignature *RootSignature,
+			REFIID Riid,
+			void **CommandSignature) override
+		{
+			return E_NOTIMPL;
+		}
+
+		void GetResourceTiling(
+			ID3D12Resource *TiledResource,
+			UINT *NumTilesForEntireResource,
+			D3D12_PACKED_MIP_INFO *PackedMipDesc,
+			D3D12_TILE_SHAPE *StandardTileShapeForNonPackedMips,
+			UINT *NumSubresourceTilings,
+			UINT FirstSubresourceTilingToGet,
+			D3D12_SUBRESOURCE_TILING *SubresourceTilingsForNonPackedMips) override
+		{
+		}
+
+		LUID GetAdapterLuid() override
+		{
+			return {};
+		}
+
+		HRESULT SetEventOnMultipleFenceCompletion(
+			ID3D12Fence *const *Fences,
+			const UINT64 *FenceValues,
+			UINT NumFences,
+			D3D12_MULTIPLE_FENCE_WAIT_FLAGS Flags,
+			HANDLE Event) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT SetResidencyPriority(UINT NumObjects, ID3D12Pageable *const *Objects, const D3D12_RESIDENCY_PRIORITY *Priorities) override
+		{
+			return S_OK;
+		}
+	};
+
+	template<typename Self, const GUID& ClassId, typename... Interfaces>
+	class DeviceChild : public ComObject<Self, ClassId, Interfaces..., ID3D12DeviceChild, ID3D12Object, IUnknown>
+	{
+	protected:
+		CComPtr<Device> m_Device;
+
+	public:
+		DeviceChild(StubDevice::Device *Device) : m_Device(Device)
+		{
+		}
+
+		HRESULT GetDevice(REFIID Riid, void **Device) override
+		{
+			return m_Device->QueryInterface(Riid, Device);
+		}
+
+		StubDevice::Device *GetOwner() const
+		{
+			return m_Device.Get();
+		}
+	};
+
+	class RootSignature : public DeviceChild<RootSignature, RootSignatureClassId, ID3D12RootSignature>
+	{
+	public:
+		const std::vector<uint8_t> m_Blob;
+
+		RootSignature(Device *Device, std::span<const uint8_t> Blob) : DeviceChild(Device), m_Blob(Blob.begin(), Blob.end())
+		{
+		}
+	};
+
+	class PipelineState : public DeviceChild<PipelineState, PipelineStateClassId, ID3D12PipelineState, ID3D12Pageable>
+	{
+	public:
+		const D3DPipelineStateStream::Fingerprint m_Fingerprint;
+
+		PipelineState(Device *Device, const D3DPipelineStateStream::Fingerprint& Fingerprint) :
+			DeviceChild(Device),
+			m_Fingerprint(Fingerprint)
+		{
+		}
+
+		HRESULT GetCachedBlob(ID3DBlob **Blob) override
+		{
+			return E_NOTIMPL;
+		}
+	};
+
+	class PipelineLibrary
+		: public DeviceChild<PipelineLibrary, PipelineLibraryClassId, ID3D12PipelineLibrary1, ID3D12PipelineLibrary>
+	{
+	private:
+		std::mutex m_Lock;
+		std::unordered_map<std::wstring, D3DPipelineStateStream::Fingerprint> m_Pipelines;
+
+	public:
+		PipelineLibrary(Device *Device, std::unordered_map<std::wstring, D3DPipelineStateStream::Fingerprint>&& Pipelines) :
+			DeviceChild(Device),
+			m_Pipelines(std::move(Pipelines))
+		{
+		}
+
+		HRESULT StorePipeline(LPCWSTR Name, ID3D12PipelineState *Pipeline) override;
+		HRESULT LoadPipeline(LPCWSTR Name, const D3D12_PIPELINE_STATE_STREAM_DESC *Desc, REFIID Riid, void **PipelineState) override;
+		SIZE_T GetSerializedSize() override;
+		HRESULT Serialize(void *Data, SIZE_T DataSize) override;
+
+		HRESULT LoadGraphicsPipeline(LPCWSTR Name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC *Desc, REFIID Riid, void **PipelineState) override
+		{
+			return E_NOTIMPL;
+		}
+
+		HRESULT LoadComputePipeline(LPCWSTR Name, const D3D12_COMPUTE_PIPELINE_STATE_DESC *Desc, REFIID Riid, void **PipelineState) override
+		{
+			return E_NOTIMPL;
+		}
+	};
+
+	std::optional<D3DPipelineStateStream::Fingerprint> Device::ValidateStream(const D3D12_PIPELINE_STATE_STREAM_DESC *Desc)
+	{
+		if (!Desc || !Desc->pPipelineStateSubobjectStream || Desc->SizeInBytes == 0)
+			return std::nullopt;
+
+		bool valid = true;
+		bool hasShader = false;
+		std::span<const uint8_t> rootSignatureData;
+
+		const bool knownTypes = D3DPipelineStateStream::ForEachSubobject(
+			Desc,
+			[&](auto Type, auto& Payload)
+			{
+				if constexpr (Type == D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE)
+				{
+					if (!Payload)
+						return;
+
+					if (auto signature = RootSignature::FromInterface(Payload); signature && signature->GetOwner() == this)
+						rootSignatureData = signature->m_Blob;
+					else
+						valid = false;
+				}
+				else
+				{
+					if constexpr (D3DPipelineStateStream::IsShaderSubobjectType(Type))
+						hasShader |= Payload.pShaderBytecode != nullptr;
+
+					// Sizes and pointers have to agree
+					D3DPipelineStateStream::ForEachReferencedBuffer(
+						Type,
+						Payload,
+						[&](auto Pointer, size_t Size)
+						{
+							if ((Pointer == nullptr) != (Size == 0))
+								valid = false;
+						});
+				}
+			});
+
+		if (!knownTypes || !valid || !hasShader)
+			return std::nullopt;
+
+		return D3DPipelineStateStream::ComputeFingerprint(Desc, rootSignatureData);
+	}
+
+	HRESULT Device::CreatePipelineState(const D3D12_PIPELINE_STATE_STREAM_DESC *Desc, REFIID Riid, void **PipelineState)
+	{
+		if (Riid != IID_ID3D12PipelineState)
+			return E_NOINTERFACE;
+
+		const auto fingerprint = ValidateStream(Desc);
+
+		if (!fingerprint)
+			return Count(&Statistics::CreatePipelineStateCount, E_INVALIDARG);
+
+		SimulateLatency(m_Options.CreatePipelineStateLatency);
+
+		if (PipelineState)
+			*PipelineState = static_cast<ID3D12PipelineState *>(new StubDevice::PipelineState(this, *fingerprint));
+
+		// A null output pointer only validates, which returns S_FALSE
+		return Count(&Statistics::CreatePipelineStateCount, PipelineState ? S_OK : S_FALSE);
+	}
+
+	HRESULT Device::CreateRootSignature(UINT NodeMask, const void *BlobWithRootSignature, SIZE_T BlobLengthInBytes, REFIID Riid, void **RootSignature)
+	{
+		if (Riid != IID_ID3D12RootSignature)
+			return E_NOINTERFACE;
+
+		if (!BlobWithRootSignature || BlobLengthInBytes == 0 || !RootSignature)
+			return Count(&Statistics::CreateRootSignatureCount, E_INVALIDARG);
+
+		SimulateLatency(m_Options.CreateRootSignatureLatency);
+
+		*RootSignature = static_cast<ID3D12RootSignature *>(
+			new StubDevice::RootSignature(this, { static_cast<const uint8_t *>(BlobWithRootSignature), BlobLengthInBytes }));
+
+		return Count(&Statistics::CreateRootSignatureCount);
+	}
+
+	HRESULT Device::CreatePipelineLibrary(const void *LibraryBlob, SIZE_T BlobLength, REFIID Riid, void **PipelineLibrary)
+	{
+		if (Riid != IID_ID3D12PipelineLibrary && Riid != IID_ID3D12PipelineLibrary1)
+			return E_NOINTERFACE;
+
+		if (!PipelineLibrary || (BlobLength != 0 && !LibraryBlob))
+			return Count(&Statistics::CreatePipelineLibraryCount, E_INVALIDARG);
+
+		std::unordered_map<std::wstring, D3DPipelineStateStream::Fingerprint> pipelines;
+
+		// Empty blobs create empty libraries
+		if (BlobLength != 0)
+		{
+			std::span data(static_cast<const uint8_t *>(LibraryBlob), BlobLength);
+			LibraryHeader header = {};
+
+			if (data.size() < sizeof(header))
+				return Count(&Statistics::CreatePipelineLibraryCount, E_INVALIDARG);
+
+			memcpy(&header, data.data(), sizeof(header));
+			data = data.subspan(sizeof(header));
+
+			// Same as a blob from another driver
+			if (header.Magic != LibraryMagic || header.Version != LibraryVersion)
+				return Count(&Statistics::CreatePipelineLibraryCount, D3D12_ERROR_DRIVER_VERSION_MISMATCH);
+
+			for (uint64_t i = 0; i < header.EntryCount; i++)
+			{
+				LibraryEntry entry = {};
+
+				if (data.size() < sizeof(entry))
+					return Count(&Statistics::CreatePipelineLibraryCount, E_INVALIDARG);
+
+				memcpy(&entry, data.data(), sizeof(entry));
+				data = data.subspan(sizeof(entry));
+
+				if (entry.NameLength > data.size() / sizeof(wchar_t))
+					return Count(&Statistics::CreatePipelineLibraryCount, E_INVALIDARG);
+
+				std::wstring name(entry.NameLength, L'\0');
+				memcpy(name.data(), data.data(), entry.NameLength * sizeof(wchar_t));
+				data = data.subspan(entry.NameLength * sizeof(wchar_t));
+
+				pipelines.emplace(std::move(name), entry.Fingerprint);
+			}
+		}
+
+		auto library = new StubDevice::PipelineLibrary(this, std::move(pipelines));
+
+		if (Riid == IID_ID3D12PipelineLibrary1)
+			*PipelineLibrary = static_cast<ID3D12PipelineLibrary1 *>(library);
+		else
+			*PipelineLibrary = static_cast<ID3D12PipelineLibrary *>(library);
+
+		return Count(&Statistics::CreatePipelineLibraryCount);
+	}
+
+	HRESULT PipelineLibrary::StorePipeline(LPCWSTR Name, ID3D12PipelineState *Pipeline)
+	{
+		auto pipeline = StubDevice::PipelineState::FromInterface(Pipeline);
+
+		if (!Name || !pipeline)
+			return m_Device->Count(&Statistics::StorePipelineCount, E_INVALIDARG);
+
+		std::scoped_lock lock(m_Lock);
+
+		// Names can't be overwritten
+		if (!m_Pipelines.emplace(Name, pipeline->m_Fingerprint).second)
+			return m_Device->Count(&Statistics::StorePipelineCount, E_INVALIDARG);
+
+		return m_Device->Count(&Statistics::StorePipelineCount);
+	}
+
+	HRESULT PipelineLibrary::LoadPipeline(LPCWSTR Name, const D3D12_PIPELINE_STATE_STREAM_DESC *Desc, REFIID Riid, void **PipelineState)
+	{
+		if (Riid != IID_ID3D12PipelineState)
+			return E_NOINTERFACE;
+
+		if (!Name || !PipelineState)
+			return m_Device->CountInvalidArgument();
+
+		const auto fingerprint = m_Device->ValidateStream(Desc);
+
+		if (!fingerprint)
+			return m_Device->CountInvalidArgument();
+
+		// Missing names and mismatched streams are both reported as E_INVALIDARG
+		{
+			std::scoped_lock lock(m_Lock);
+
+			if (auto itr = m_Pipelines.find(Name); itr == m_Pipelines.end() || itr->second != *fingerprint)
+				return m_Device->Count(&Statistics::LoadPipelineMissCount, E_INVALIDARG);
+		}
+
+		Device::SimulateLatency(m_Device->GetOptions().LoadPipelineLatency);
+
+		*PipelineState = static_cast<ID3D12PipelineState *>(new StubDevice::PipelineState(m_Device.Get(), *fingerprint));
+		return m_Device->Count(&Statistics::LoadPipelineHitCount);
+	}
+
+	SIZE_T PipelineLibrary::GetSerializedSize()
+	{
+		std::scoped_lock lock(m_Lock);
+		size_t size = sizeof(LibraryHeader);
+
+		for (const auto& [name, fingerprint] : m_Pipelines)
+			size += sizeof(LibraryEntry) + name.size() * sizeof(wchar_t);
+
+		return size;
+	}
+
+	HRESULT PipelineLibrary::Serialize(void *Data, SIZE_T DataSize)
+	{
+		if (!Data || DataSize < GetSerializedSize())
+			return m_Device->CountInvalidArgument();
+
+		std::scoped_lock lock(m_Lock);
+		auto out = static_cast<uint8_t *>(Data);
+
+		const LibraryHeader header {
+			.Magic = LibraryMagic,
+			.Version = LibraryVersion,
+			.EntryCount = m_Pipelines.size(),
+		};
+
+		out = static_cast<uint8_t *>(memcpy(out, &header, sizeof(header))) + sizeof(header);
+
+		for (const auto& [name, fingerprint] : m_Pipelines)
+		{
+			const LibraryEntry entry {
+				.Fingerprint = fingerprint,
+				.NameLength = name.size(),
+			};
+
+			out = static_cast<uint8_t *>(memcpy(out, &entry, sizeof(entry))) + sizeof(entry);
+			out = static_cast<uint8_t *>(memcpy(out, name.data(), name.size() * sizeof(wchar_t))) + name.size() * sizeof(wchar_t);
+		}
+
+		return S_OK;
+	}
+
+	CComPtr<ID3D12Device2> Create(const Options& Options)
+	{
+		CComPtr<ID3D12Device2> device;
+		device.Attach(new Device(Options));
+
+		return device;
+	}
+
+	Statistics GetStatistics(ID3D12Device2 *Device)
+	{
+		if (auto device = Device::FromInterface(Device))
+			return device->GetStatistics();
+
+		return {};
+	}
+
+	std::optional<D3DPipelineStateStream::Fingerprint> GetPipelineFingerprint(ID3D12PipelineState *PipelineState)
+	{
+		if (auto pipeline = StubDevice::PipelineState::FromInterface(PipelineState))
+			return pipeline->m_Fingerprint;
+
+		return std::nullopt;
+	}
+}
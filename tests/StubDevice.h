@@ -0,0 +1,37 @@
+#pragma once
+
+#include "CComPtr.h"
+#include "D3DPipelineStateStream.h"
+
+namespace StubDevice
+{
+	//
+	// In-process stand-in for ID3D12Device2 and ID3D12PipelineLibrary1. Nothing is compiled and no GPU is
+	// needed. Pipelines remember the fingerprint of the stream they were created from, libraries map names to
+	// fingerprints, and invalid input is rejected with E_INVALIDARG like the real runtime does. Used to drive
+	// CreatePipelineStateForTechnique, PipelineCapture::Replay and the live update path without the game.
+	//
+	struct Options
+	{
+		std::chrono::microseconds CreatePipelineStateLatency = {}; // Simulated compile time per pipeline
+		std::chrono::microseconds CreateRootSignatureLatency = {};
+		std::chrono::microseconds LoadPipelineLatency = {}; // Only applies to library hits
+	};
+
+	struct Statistics
+	{
+		size_t CreatePipelineStateCount = 0;
+		size_t CreateRootSignatureCount = 0;
+		size_t CreatePipelineLibraryCount = 0;
+		size_t LoadPipelineHitCount = 0;
+		size_t LoadPipelineMissCount = 0;
+		size_t StorePipelineCount = 0;
+		size_t InvalidArgumentCount = 0; // Calls of any kind that returned E_INVALIDARG
+	};
+
+	CComPtr<ID3D12Device2> Create(const Options& Options = {});
+
+	// Both return empty values for objects that weren't created by a stub device
+	Statistics GetStatistics(ID3D12Device2 *Device);
+	std::optional<D3DPipelineStateStream::Fingerprint> GetPipelineFingerprint(ID3D12PipelineState *PipelineState);
+}
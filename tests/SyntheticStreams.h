@@ -0,0 +1,339 @@
+#pragma once
+
+#include "D3DPipelineStateStream.h"
+
+namespace SyntheticStreams
+{
+	//
+	// Pipeline state stream built in memory, laid out the way the runtime reads it: every subobject starts
+	// pointer aligned with its type, followed by the payload at the payload's own alignment. Owns everything the
+	// payloads point to. Moving a Stream keeps those pointers valid.
+	//
+	class Stream
+	{
+	private:
+		std::vector<uint64_t> m_Storage; // uint64_t keeps the subobject stream pointer aligned
+		size_t m_Size = 0;
+		std::vector<std::unique_ptr<uint8_t[]>> m_Buffers;
+
+	public:
+		template<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type>
+		void Add(const typename D3DPipelineStateStream::SubobjectPayload<Type>::type& Payload)
+		{
+			using Payload_t = D3DPipelineStateStream::SubobjectPayload<Type>::type;
+
+			const auto typeOffset = AlignUp(m_Size, alignof(void *));
+			const auto payloadOffset = AlignUp(typeOffset + sizeof(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE), alignof(Payload_t));
+			const auto type = Type;
+
+			m_Size = AlignUp(payloadOffset + sizeof(Payload_t), alignof(void *));
+			m_Storage.resize(m_Size / sizeof(uint64_t), 0);
+
+			const auto data = reinterpret_cast<uint8_t *>(m_Storage.data());
+			memcpy(data + typeOffset, &type, sizeof(type));
+			memcpy(data + payloadOffset, &Payload, sizeof(Payload));
+		}
+
+		// Copies Data into memory owned by the stream
+		template<typename T>
+		const T *Own(std::span<const T> Data)
+		{
+			if (Data.empty())
+				return nullptr;
+
+			auto& buffer = m_Buffers.emplace_back(std::make_unique<uint8_t[]>(Data.size_bytes()));
+			memcpy(buffer.get(), Data.data(), Data.size_bytes());
+
+			return reinterpret_cast<const T *>(buffer.get());
+		}
+
+		const char *Own(std::string_view String)
+		{
+			auto& buffer = m_Buffers.emplace_back(std::make_unique<uint8_t[]>(String.size() + 1));
+			memcpy(buffer.get(), String.data(), String.size());
+
+			return reinterpret_cast<const char *>(buffer.get());
+		}
+
+		D3D12_PIPELINE_STATE_STREAM_DESC GetDesc() const
+		{
+			return { m_Size, const_cast<uint64_t *>(m_Storage.data()) };
+		}
+
+		// Subobject stream bytes only, for corrupting streams in tests
+		std::span<uint8_t> GetBytes()
+		{
+			return { reinterpret_cast<uint8_t *>(m_Storage.data()), m_Size };
+		}
+
+	private:
+		static size_t AlignUp(size_t Value, size_t Alignment)
+		{
+			return (Value + (Alignment - 1)) & ~(Alignment - 1);
+		}
+	};
+
+	// Finds the payload of the first subobject of the given type so tests can inspect or modify it in place
+	template<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type>
+	auto& GetPayload(const Stream& Stream)
+	{
+		using Payload_t = D3DPipelineStateStream::SubobjectPayload<Type>::type;
+		const auto desc = Stream.GetDesc();
+		Payload_t *result = nullptr;
+
+		D3DPipelineStateStream::ForEachSubobject(
+			&desc,
+			[&](auto SubobjectType, auto& Payload)
+			{
+				if constexpr (SubobjectType == Type)
+				{
+					if (!result)
+						result = &Payload;
+				}
+			});
+
+		return *result;
+	}
+
+	// Deterministic bytes standing in for DXIL. Different seeds never produce the same contents.
+	inline std::vector<uint8_t> MakeShader(uint32_t Seed, size_t Size)
+	{
+		std::vector<uint8_t> data(std::max<size_t>(Size, 8));
+		uint32_t state = (Seed * 2654435761u) | 1;
+
+		memcpy(data.data(), "DXBC", 4);
+		memcpy(data.data() + 4, &Seed, sizeof(Seed));
+
+		for (size_t i = 8; i < data.size(); i++)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			data[i] = static_cast<uint8_t>(state);
+		}
+
+		return data;
+	}
+
+	inline D3D12_SHADER_BYTECODE AddShader(Stream& Stream, uint32_t Seed, size_t Size)
+	{
+		const auto data = MakeShader(Seed, Size);
+		return { Stream.Own(std::span<const uint8_t>(data)), data.size() };
+	}
+
+	inline D3D12_INPUT_LAYOUT_DESC AddInputLayout(Stream& Stream, uint32_t Seed)
+	{
+		constexpr std::array semantics = { "POSITION", "NORMAL", "TEXCOORD", "TANGENT", "COLOR" };
+
+		// Names are copied per stream on purpose. Only their contents may matter, never their addresses.
+		std::vector<D3D12_INPUT_ELEMENT_DESC> elements;
+		UINT offset = 0;
+
+		for (uint32_t i = 0; i < 2 + (Seed % 4); i++)
+		{
+			const auto format = (i == 0) ? DXGI_FORMAT_R32G32B32_FLOAT : DXGI_FORMAT_R16G16B16A16_FLOAT;
+
+			elements.push_back({
+				.SemanticName = Stream.Own(std::string_view(semantics[i % semantics.size()])),
+				.SemanticIndex = i / static_cast<uint32_t>(semantics.size()),
+				.Format = format,
+				.InputSlot = 0,
+				.AlignedByteOffset = offset,
+				.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
+				.InstanceDataStepRate = 0,
+			});
+
+			offset += (i == 0) ? 12 : 8;
+		}
+
+		return { Stream.Own(std::span<const D3D12_INPUT_ELEMENT_DESC>(elements)), static_cast<UINT>(elements.size()) };
+	}
+
+	inline D3D12_BLEND_DESC MakeBlend(bool Enable)
+	{
+		D3D12_BLEND_DESC desc = {};
+
+		for (auto& target : desc.RenderTarget)
+		{
+			target.BlendEnable = Enable;
+			target.SrcBlend = Enable ? D3D12_BLEND_SRC_ALPHA : D3D12_BLEND_ONE;
+			target.DestBlend = Enable ? D3D12_BLEND_INV_SRC_ALPHA : D3D12_BLEND_ZERO;
+			target.BlendOp = D3D12_BLEND_OP_ADD;
+			target.SrcBlendAlpha = D3D12_BLEND_ONE;
+			target.DestBlendAlpha = D3D12_BLEND_ZERO;
+			target.BlendOpAlpha = D3D12_BLEND_OP_ADD;
+			target.LogicOp = D3D12_LOGIC_OP_NOOP;
+			target.RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+		}
+
+		return desc;
+	}
+
+	inline D3D12_RASTERIZER_DESC MakeRasterizer(uint32_t Seed)
+	{
+		return {
+			.FillMode = D3D12_FILL_MODE_SOLID,
+			.CullMode = (Seed % 3 == 0) ? D3D12_CULL_MODE_NONE : D3D12_CULL_MODE_BACK,
+			.FrontCounterClockwise = FALSE,
+			.DepthBias = static_cast<INT>(Seed % 5),
+			.DepthBiasClamp = 0.0f,
+			.SlopeScaledDepthBias = 0.0f,
+			.DepthClipEnable = TRUE,
+			.MultisampleEnable = FALSE,
+			.AntialiasedLineEnable = FALSE,
+			.ForcedSampleCount = 0,
+			.ConservativeRaster = D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF,
+		};
+	}
+
+	template<typename T>
+	T MakeDepthStencil(uint32_t Seed)
+	{
+		const D3D12_DEPTH_STENCILOP_DESC stencilOp = {
+			.StencilFailOp = D3D12_STENCIL_OP_KEEP,
+			.StencilDepthFailOp = D3D12_STENCIL_OP_KEEP,
+			.StencilPassOp = D3D12_STENCIL_OP_REPLACE,
+			.StencilFunc = D3D12_COMPARISON_FUNC_ALWAYS,
+		};
+
+		T desc = {};
+		desc.DepthEnable = TRUE;
+		desc.DepthWriteMask = (Seed % 2) ? D3D12_DEPTH_WRITE_MASK_ALL : D3D12_DEPTH_WRITE_MASK_ZERO;
+		desc.DepthFunc = D3D12_COMPARISON_FUNC_GREATER_EQUAL;
+		desc.StencilEnable = (Seed % 7) == 0;
+		desc.StencilReadMask = 0xFF;
+		desc.StencilWriteMask = 0xFF;
+		desc.FrontFace = stencilOp;
+		desc.BackFace = stencilOp;
+
+		return desc;
+	}
+
+	inline D3D12_RT_FORMAT_ARRAY MakeRenderTargetFormats(uint32_t Seed)
+	{
+		D3D12_RT_FORMAT_ARRAY formats = {};
+		formats.NumRenderTargets = 1 + (Seed % 4);
+
+		for (UINT i = 0; i < formats.NumRenderTargets; i++)
+			formats.RTFormats[i] = (i == 0) ? DXGI_FORMAT_R11G11B10_FLOAT : DXGI_FORMAT_R8G8B8A8_UNORM;
+
+		return formats;
+	}
+
+	// Shaped like the game's graphics pipelines: VS/PS with an input layout and the usual fixed function state
+	inline Stream MakeGraphicsStream(uint32_t Seed, size_t ShaderSize = 8192)
+	{
+		Stream stream;
+		const auto vs = AddShader(stream, Seed * 2, ShaderSize / 2);
+		const auto ps = AddShader(stream, Seed * 2 + 1, ShaderSize);
+		const auto inputLayout = AddInputLayout(stream, Seed);
+
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE>(nullptr);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS>(vs);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS>(ps);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_BLEND>(MakeBlend(Seed % 2));
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_MASK>(D3D12_DEFAULT_SAMPLE_MASK);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RASTERIZER>(MakeRasterizer(Seed));
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL1>(MakeDepthStencil<D3D12_DEPTH_STENCIL_DESC1>(Seed));
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT>(inputLayout);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PRIMITIVE_TOPOLOGY>(D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RENDER_TARGET_FORMATS>(MakeRenderTargetFormats(Seed));
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL_FORMAT>(DXGI_FORMAT_D32_FLOAT);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_DESC>({ 1, 0 });
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_NODE_MASK>(0);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_FLAGS>(D3D12_PIPELINE_STATE_FLAG_NONE);
+
+		return stream;
+	}
+
+	inline Stream MakeComputeStream(uint32_t Seed, size_t ShaderSize = 8192)
+	{
+		Stream stream;
+		const auto cs = AddShader(stream, Seed, ShaderSize);
+
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE>(nullptr);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS>(cs);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_NODE_MASK>(0);
+
+		return stream;
+	}
+
+	// Mix of both kinds with shader sizes spread out like compiled DXIL
+	inline Stream MakeGameLikeStream(uint32_t Seed)
+	{
+		const size_t shaderSize = 1024 + (Seed * 7919) % (48 * 1024);
+
+		if (Seed % 5 == 0)
+			return MakeComputeStream(Seed, shaderSize);
+
+		return MakeGraphicsStream(Seed, shaderSize);
+	}
+
+	// One of every subobject type the iterator knows, with every pointer field set
+	inline Stream MakeEveryTypeStream(uint32_t Seed, const void *CachedBlob = nullptr, size_t CachedBlobSize = 0)
+	{
+		Stream stream;
+
+		const auto shaderSeed = Seed * 8;
+		const auto vs = AddShader(stream, shaderSeed + 0, 700);
+		const auto ps = AddShader(stream, shaderSeed + 1, 900);
+		const auto ds = AddShader(stream, shaderSeed + 2, 300);
+		const auto hs = AddShader(stream, shaderSeed + 3, 301);
+		const auto gs = AddShader(stream, shaderSeed + 4, 302);
+		const auto cs = AddShader(stream, shaderSeed + 5, 303);
+		const auto as = AddShader(stream, shaderSeed + 6, 304);
+		const auto ms = AddShader(stream, shaderSeed + 7, 305);
+
+		const D3D12_SO_DECLARATION_ENTRY soEntries[] = {
+			{ 0, stream.Own(std::string_view("SV_Position")), 0, 0, 4, 0 },
+			{ 0, stream.Own(std::string_view("TEXCOORD")), 1, 0, 2, 1 },
+			{ 1, nullptr, 0, 0, 3, 2 }, // Gaps have no semantic name
+		};
+
+		const UINT soStrides[] = { 16, 8, 12 };
+
+		const D3D12_STREAM_OUTPUT_DESC streamOutput = {
+			.pSODeclaration = stream.Own(std::span<const D3D12_SO_DECLARATION_ENTRY>(soEntries)),
+			.NumEntries = static_cast<UINT>(std::size(soEntries)),
+			.pBufferStrides = stream.Own(std::span<const UINT>(soStrides)),
+			.NumStrides = static_cast<UINT>(std::size(soStrides)),
+			.RasterizedStream = 0,
+		};
+
+		const D3D12_VIEW_INSTANCE_LOCATION viewLocations[] = { { 0, 0 }, { 1, 1 } };
+
+		const D3D12_VIEW_INSTANCING_DESC viewInstancing = {
+			.ViewInstanceCount = static_cast<UINT>(std::size(viewLocations)),
+			.pViewInstanceLocations = stream.Own(std::span<const D3D12_VIEW_INSTANCE_LOCATION>(viewLocations)),
+			.Flags = D3D12_VIEW_INSTANCING_FLAG_NONE,
+		};
+
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE>(nullptr);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS>(vs);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS>(ps);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS>(ds);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS>(hs);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS>(gs);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS>(cs);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT>(streamOutput);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_BLEND>(MakeBlend(true));
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_MASK>(0x0F0F0F0F ^ Seed);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RASTERIZER>(MakeRasterizer(Seed));
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL>(MakeDepthStencil<D3D12_DEPTH_STENCIL_DESC>(Seed));
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT>(AddInputLayout(stream, Seed));
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_IB_STRIP_CUT_VALUE>(D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_0xFFFFFFFF);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PRIMITIVE_TOPOLOGY>(D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RENDER_TARGET_FORMATS>(MakeRenderTargetFormats(Seed));
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL_FORMAT>(DXGI_FORMAT_D24_UNORM_S8_UINT);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_DESC>({ 4, 1 });
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_NODE_MASK>(1);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CACHED_PSO>({ CachedBlob, CachedBlobSize });
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_FLAGS>(D3D12_PIPELINE_STATE_FLAG_TOOL_DEBUG);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL1>(MakeDepthStencil<D3D12_DEPTH_STENCIL_DESC1>(Seed + 1));
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VIEW_INSTANCING>(viewInstancing);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_AS>(as);
+		stream.Add<D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_MS>(ms);
+
+		return stream;
+	}
+}
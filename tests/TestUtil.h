@@ -0,0 +1,69 @@
+#pragma once
+
+namespace TestUtil
+{
+	inline size_t FailureCount = 0;
+
+	inline void Check(bool Condition, const char *Expression, const char *File, int Line)
+	{
+		if (Condition)
+			return;
+
+		spdlog::error("{}({}): Check failed: {}", File, Line, Expression);
+		FailureCount++;
+	}
+
+	// Process exit code for main()
+	inline int Finish()
+	{
+		if (FailureCount > 0)
+			spdlog::error("{} check(s) failed.", FailureCount);
+
+		return FailureCount > 0 ? 1 : 0;
+	}
+
+	// Average wall time of one call in nanoseconds
+	template<typename T>
+	double MeasureNanoseconds(size_t Iterations, T&& Callback)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		for (size_t i = 0; i < Iterations; i++)
+			Callback(i);
+
+		const auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(end - start).count() / std::max<size_t>(Iterations, 1);
+	}
+
+	// Unique directory under the system temp path. Removed again along with everything in it.
+	class TemporaryDirectory
+	{
+	private:
+		std::filesystem::path m_Path;
+
+	public:
+		explicit TemporaryDirectory(std::string_view Name)
+		{
+			const auto seed = std::chrono::steady_clock::now().time_since_epoch().count();
+			m_Path = std::filesystem::temp_directory_path() / fmt::format("{}_{:X}", Name, seed);
+
+			std::filesystem::create_directories(m_Path);
+		}
+
+		TemporaryDirectory(const TemporaryDirectory&) = delete;
+		TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+		~TemporaryDirectory()
+		{
+			std::error_code ec;
+			std::filesystem::remove_all(m_Path, ec);
+		}
+
+		const std::filesystem::path& GetPath() const
+		{
+			return m_Path;
+		}
+	};
+}
+
+#define CHECK(Condition) TestUtil::Check(static_cast<bool>(Condition), #Condition, __FILE__, __LINE__)
@@ -0,0 +1,38 @@
+#pragma once
+
+//
+// Portable stand-in for source/pch.h. Only what the plugin modules under test expect to be included already.
+// D3D12 types come from the Windows SDK or from DirectX-Headers' WSL adapter everywhere else.
+//
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <wsl/winadapter.h>
+#include <strings.h>
+
+#ifndef _stricmp
+#define _stricmp strcasecmp
+#endif
+
+#ifndef _strnicmp
+#define _strnicmp strncasecmp
+#endif
+#endif // _WIN32
+
+#include <d3d12.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <variant>
+#include <vector>